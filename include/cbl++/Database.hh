@@ -100,15 +100,36 @@ namespace cbl {
         const char* path() const _cbl_nonnull               {return CBLDatabase_Path(ref());}
         uint64_t count() const                              {return CBLDatabase_Count(ref());}
         CBLDatabaseConfiguration config() const             {return CBLDatabase_Config(ref());}
+        CBLDocumentCacheStats documentCacheStats() const    {return CBLDatabase_DocumentCacheStats(ref());}
+
+        CBLDatabaseStats stats() const {
+            CBLDatabaseStats stats;
+            CBLError error;
+            check(CBLDatabase_GetStats(ref(), &stats, &error), error);
+            return stats;
+        }
 
         // Documents:
 
         inline Document getDocument(const char *id _cbl_nonnull) const;
+        inline std::vector<Document> getDocuments(const std::vector<const char*> &ids) const;
         inline MutableDocument getMutableDocument(const char *id _cbl_nonnull) const;
 
         inline Document saveDocument(MutableDocument &doc,
                                      CBLConcurrencyControl c = kCBLConcurrencyControlFailOnConflict);
 
+        inline std::vector<CBLError> saveDocuments(std::vector<MutableDocument> &docs,
+                                     CBLConcurrencyControl c = kCBLConcurrencyControlFailOnConflict);
+
+        bool getDocumentInfo(const char *docID, CBLDocumentInfo &info,
+                             CBLDocumentInfoFields fields =0) const {
+            CBLError error;
+            bool exists = CBLDatabase_GetDocumentInfo(ref(), docID, fields, &info, &error);
+            if (!exists && error.code != 0)
+                throw error;
+            return exists;
+        }
+
         time_t getDocumentExpiration(const char *docID) const {
             CBLError error;
             time_t exp = CBLDatabase_GetDocumentExpiration(ref(), docID, &error);
@@ -177,4 +198,62 @@ namespace cbl {
         CBL_REFCOUNTED_BOILERPLATE(Database, RefCounted, CBLDatabase)
     };
 
+
+    /** A batch operation on a Database that's ended (committed) when the Batch is destructed,
+        or when `end` is called. */
+    class Batch {
+    public:
+        using ChunkCallback = std::function<void(uint64_t docs, uint64_t bytes)>;
+
+        /** Begins a regular batch. */
+        explicit Batch(Database db)
+        :_db(db)
+        {
+            CBLError error;
+            if (!CBLDatabase_BeginBatch(_db.ref(), &error))
+                throw error;
+        }
+
+        /** Begins an auto-chunking batch that commits every `maxDocs` documents or `maxBytes`
+            bytes. (See \ref CBLDatabase_BeginAutoBatch.) */
+        Batch(Database db, uint64_t maxDocs, uint64_t maxBytes, ChunkCallback callback = nullptr)
+        :_db(db)
+        ,_callback(callback)
+        {
+            CBLError error;
+            if (!CBLDatabase_BeginAutoBatch(_db.ref(), maxDocs, maxBytes,
+                                            (_callback ? &_callChunk : nullptr), this, &error))
+                throw error;
+        }
+
+        ~Batch() {
+            if (_active) {
+                CBLError error;
+                CBLDatabase_EndBatch(_db.ref(), &error);
+            }
+        }
+
+        /** Ends the batch now, throwing an exception on error. */
+        void end() {
+            if (_active) {
+                _active = false;
+                CBLError error;
+                if (!CBLDatabase_EndBatch(_db.ref(), &error))
+                    throw error;
+            }
+        }
+
+        Batch(const Batch&) =delete;
+        Batch& operator=(const Batch&) =delete;
+
+    private:
+        static void _callChunk(void *context, CBLDatabase*, uint64_t docs, uint64_t bytes) {
+            ((Batch*)context)->_callback(docs, bytes);
+        }
+
+        Database _db;
+        ChunkCallback _callback;
+        bool _active {true};
+    };
+
 }
@@ -39,6 +39,10 @@ namespace cbl {
 
         fleece::Dict properties() const                 {return CBLDocument_Properties(ref());}
 
+        fleece::alloc_slice propertiesAsJSON() const {
+            return fleece::alloc_slice(CBLDocument_PropertiesToJSON(ref()));
+        }
+
         char* _cbl_nonnull propertiesAsJSON(const CBLDocument* _cbl_nonnull);
 
         bool CBLDocument_setPropertiesAsJSON(CBLDocument* _cbl_nonnull,
@@ -113,6 +117,16 @@ namespace cbl {
         return Document::adopt(CBLDatabase_GetDocument(ref(), id));
     }
 
+    inline std::vector<Document> Database::getDocuments(const std::vector<const char*> &ids) const {
+        std::vector<const CBLDocument*> docs(ids.size());
+        CBLDatabase_GetDocuments(ref(), ids.data(), ids.size(), docs.data());
+        std::vector<Document> result;
+        result.reserve(docs.size());
+        for (auto doc : docs)
+            result.push_back(Document::adopt(doc));
+        return result;
+    }
+
     inline MutableDocument Database::getMutableDocument(const char *id _cbl_nonnull) const {
         return MutableDocument::adopt(CBLDatabase_GetMutableDocument(ref(), id));
     }
@@ -126,8 +140,27 @@ namespace cbl {
     }
 
 
+    inline std::vector<CBLError> Database::saveDocuments(std::vector<MutableDocument> &docs,
+                                                         CBLConcurrencyControl c)
+    {
+        std::vector<CBLDocument*> refs;
+        refs.reserve(docs.size());
+        for (auto &doc : docs)
+            refs.push_back(doc.ref());
+        std::vector<CBLError> errors(docs.size());
+        CBLError error;
+        check(CBLDatabase_SaveDocuments(ref(), refs.data(), refs.size(), c, errors.data(), &error),
+              error);
+        return errors;
+    }
+
+
     inline MutableDocument Document::mutableCopy() const {
-        return MutableDocument::adopt(CBLDocument_MutableCopy(ref()));
+        CBLDocument *copy = CBLDocument_MutableCopy(ref());
+        // (It fails only if this document's body wasn't read, as by a metadata-only enumerator.)
+        CBLError error = {CBLDomain, CBLErrorUnsupported, 0};
+        check(copy != nullptr, error);
+        return MutableDocument::adopt(copy);
     }
 
 
@@ -199,6 +199,9 @@ void CBL_DumpInstances(void) CBLAPI;
      @{ */
 /** A connection to an open database. */
 typedef struct CBLDatabase   CBLDatabase;
+
+/** A consistent, read-only view of a database at a point in time. */
+typedef struct CBLSnapshot   CBLSnapshot;
 /** @} */
 
 /** \defgroup documents  Documents
@@ -267,7 +270,9 @@ typedef struct CBLReplicator CBLReplicator;
     calling \ref CBLListener_Remove. */
 typedef struct CBLListenerToken CBLListenerToken;
 
-/** Removes a listener callback, given the token that was returned when it was added. */
+/** Removes a listener callback, given the token that was returned when it was added.
+    If the listener is being called on another thread, this waits for that call to return, so
+    once this function returns the listener won't be called again. */
 void CBLListener_Remove(CBLListenerToken*) CBLAPI;
 
 
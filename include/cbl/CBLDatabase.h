@@ -18,6 +18,7 @@
 
 #pragma once
 #include "CBLBase.h"
+#include "fleece/Fleece.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -58,11 +59,43 @@ typedef struct CBLEncryptionKey {
     uint8_t bytes[32];                      ///< Raw key data
 } CBLEncryptionKey;
 
-/** Database configuration options. */
+/** Durability levels for \ref CBLStorageTuning: how hard the storage engine works to make sure
+    committed changes survive a crash, at the expense of write speed. */
+typedef CBL_ENUM(uint32_t, CBLDurability) {
+    kCBLDurabilityDefault = 0,      ///< The default, currently the same as Normal
+    kCBLDurabilityFull,             ///< Syncs on every commit, so commits survive power loss
+    kCBLDurabilityNormal,           ///< Commits survive an app crash, but maybe not power loss
+    kCBLDurabilityOff,              ///< Never syncs; power loss may corrupt the database
+};
+
+/** Storage engine tuning options in a \ref CBLDatabaseConfiguration. They're applied to each of
+    the database's connections to the file. Zero values leave the defaults unchanged.
+    @note  `kCBLDurabilityOff` is only appropriate for databases that can be recreated, such as
+           caches. */
+typedef struct {
+    uint32_t pageCacheSize;                 ///< Page cache size per connection, in KB
+    int64_t mmapSize;                       ///< Max bytes of the file to memory-map, or -1 for none
+    CBLDurability durability;               ///< How thoroughly commits are synced to disk
+    int32_t walAutoCheckpoint;              ///< WAL pages that trigger a checkpoint, or -1 for never
+    int64_t journalSizeLimit;               ///< Bytes the WAL is truncated to after a checkpoint, or -1 for no limit
+} CBLStorageTuning;
+
+/** Database configuration options.
+    Setting `readerCount` gives the database a pool of read-only connections to the file, which
+    \ref CBLDatabase_GetDocument, \ref CBLDatabase_GetDocuments and \ref CBLQuery_Execute use
+    in turn, so that reads on multiple threads can run in parallel instead of waiting for each
+    other and for writes. (Reads made during a batch use the main connection, so they can see
+    the batch's changes.) The connections are shared, not reserved per read, so threads only
+    avoid waiting for each other if there are at least as many readers as reading threads. */
 typedef struct {
     const char *directory;                  ///< The parent directory of the database
     CBLDatabaseFlags flags;                 ///< Options for opening the database
     CBLEncryptionKey encryptionKey;         ///< The database's encryption key (if any)
+    uint64_t documentCacheSize;             ///< Max bytes of immutable documents to cache, or 0
+    uint32_t saveGroupMaxDocs;              ///< Max docs committed together by async saves (0 = default)
+    uint32_t saveGroupMaxDelay;             ///< Max microseconds an async save waits to be grouped
+    uint32_t readerCount;                   ///< Number of read-only connections for reads/queries
+    CBLStorageTuning tuning;                ///< Storage engine performance settings
 } CBLDatabaseConfiguration;
 
 /** @} */
@@ -142,9 +175,49 @@ bool CBLDatabase_Compact(CBLDatabase* _cbl_nonnull, CBLError*) CBLAPI;
     @note  Batch operations can nest. Changes are not committed until the outer batch ends. */
 bool CBLDatabase_BeginBatch(CBLDatabase* _cbl_nonnull, CBLError*) CBLAPI;
 
-/** Ends a batch operation. This **must** be called after \ref CBLDatabase_BeginBatch. */
+/** Ends a batch operation. This **must** be called after \ref CBLDatabase_BeginBatch or
+    \ref CBLDatabase_BeginAutoBatch. */
 bool CBLDatabase_EndBatch(CBLDatabase* _cbl_nonnull, CBLError*) CBLAPI;
 
+/** A callback invoked by an auto-batch (see \ref CBLDatabase_BeginAutoBatch) every time it
+    commits a chunk of changes, including the final one when the batch ends.
+    @param context  The value given to \ref CBLDatabase_BeginAutoBatch.
+    @param db  The database.
+    @param docsCommitted  The number of documents saved or deleted in the chunk.
+    @param bytesCommitted  The total size of the document bodies saved in the chunk. */
+typedef void (*CBLBatchChunkCallback)(void *context,
+                                      CBLDatabase* db,
+                                      uint64_t docsCommitted,
+                                      uint64_t bytesCommitted);
+
+/** Begins an auto-chunking batch operation, for long-running imports. This works like
+    \ref CBLDatabase_BeginBatch, except that the changes are committed, and a new transaction
+    begun, every time `maxDocs` documents or `maxBytes` bytes of document bodies have been
+    saved. That keeps the database's write-ahead log from growing without limit and lets other
+    connections see the changes, while still committing far less often than once per document.
+    You **must** later call \ref CBLDatabase_EndBatch to end the batch.
+    @note  While a regular batch is nested inside the auto-batch, no chunks are committed.
+           An auto-batch nested inside another batch acts like a regular batch.
+    @note  Since each chunk is committed, the changes are not atomic as a whole.
+    @note  If a chunk fails to commit, its changes are lost: the save that triggered the commit
+           fails with the error, and so does \ref CBLDatabase_EndBatch. Saves made after the
+           failure, but before the batch ends, are committed individually.
+    @warning  The chunks are committed during calls that save documents, so all such calls
+              during the batch should be made on the same thread.
+    @param db  The database.
+    @param maxDocs  The number of documents per chunk, or 0 for no limit.
+    @param maxBytes  The approximate number of bytes per chunk, or 0 for no limit.
+    @param callback  A callback to invoke after each chunk is committed, or NULL.
+    @param context  An arbitrary value to be passed to the callback.
+    @param error  On failure, the error will be written here.
+    @return  True on success, false on failure. */
+bool CBLDatabase_BeginAutoBatch(CBLDatabase* db _cbl_nonnull,
+                                uint64_t maxDocs,
+                                uint64_t maxBytes,
+                                CBLBatchChunkCallback callback,
+                                void *context,
+                                CBLError* error) CBLAPI;
+
 /** Returns the nearest future time at which a document in this database will expire,
     or 0 if no documents will expire. */
 time_t CBLDatabase_NextDocExpiration(CBLDatabase* _cbl_nonnull) CBLAPI;
@@ -156,6 +229,268 @@ time_t CBLDatabase_NextDocExpiration(CBLDatabase* _cbl_nonnull) CBLAPI;
 int64_t CBLDatabase_PurgeExpiredDocuments(CBLDatabase* db _cbl_nonnull,
                                           CBLError* error) CBLAPI;
 
+/** Options for \ref CBLDatabase_StartExpirationScheduler. */
+typedef struct {
+    uint32_t maxDocsPerTransaction;     ///< Max docs purged per transaction (0 for default, 500)
+    uint32_t maxMillisPerTransaction;   ///< Max duration of a transaction (0 for default, 50ms)
+    uint32_t pauseMillis;               ///< Time to wait between transactions, in ms
+} CBLExpirationSchedulerOptions;
+
+/** Statistics of a database's expiration scheduler. */
+typedef struct {
+    uint64_t docsPurged;                ///< Number of expired documents purged
+    uint64_t transactions;              ///< Number of transactions committed
+    int64_t lagSeconds;                 ///< How long the oldest doc purged last had been expired
+    int64_t maxLagSeconds;              ///< Largest value of `lagSeconds` so far
+    uint32_t maxTransactionMillis;      ///< Duration of the longest transaction
+    time_t nextExpiration;              ///< When the scheduler will next purge, or 0 if never
+} CBLExpirationStats;
+
+/** Starts a background thread that purges documents soon after they expire, so the app doesn't
+    have to call \ref CBLDatabase_PurgeExpiredDocuments itself.
+    Unlike that function, it purges in small transactions, limited by the given number of
+    documents or milliseconds, with pauses between them, so that it never keeps other writers
+    waiting for long.
+    The scheduler sleeps until the time given by \ref CBLDatabase_NextDocExpiration. It notices
+    expiration times set through this database instance immediately, but may take up to a
+    minute to notice ones set through other instances.
+    The scheduler is stopped when the database is closed.
+    @param db  The database.
+    @param options  Limits on the purge transactions, or NULL for the defaults.
+    @param error  On failure, the error will be written here.
+    @return  True if the scheduler was started or was already running, false on error. */
+bool CBLDatabase_StartExpirationScheduler(CBLDatabase* db _cbl_nonnull,
+                                          const CBLExpirationSchedulerOptions *options,
+                                          CBLError* error) CBLAPI;
+
+/** Stops the database's expiration scheduler, if it's running. */
+void CBLDatabase_StopExpirationScheduler(CBLDatabase* db _cbl_nonnull) CBLAPI;
+
+/** Returns statistics of the database's expiration scheduler since it was started.
+    If it's never been started, all the values are zero. */
+CBLExpirationStats CBLDatabase_ExpirationStats(const CBLDatabase* db _cbl_nonnull) CBLAPI;
+
+/** Statistics of a database's background compaction. */
+typedef struct {
+    uint64_t fileSize;                  ///< Size of the database file, at the last check
+    uint64_t freeBytes;                 ///< Bytes in free pages, at the last check
+    double fragmentation;               ///< Fraction of the file that's free pages
+    uint64_t bytesReclaimed;            ///< Total bytes returned to the filesystem
+    uint64_t steps;                     ///< Number of compaction steps (transactions) run
+    uint32_t maxStepMillis;             ///< Duration of the longest step
+} CBLCompactionStats;
+
+/** A callback invoked on a background thread after each step of background compaction.
+    It must not call \ref CBLDatabase_StopAutoCompaction or close the database.
+    @param context  The `context` given in the \ref CBLAutoCompactionOptions.
+    @param db  The database.
+    @param bytesReclaimed  The number of bytes the step removed from the file.
+    @param stats  The compaction statistics, updated after the step. */
+typedef void (*CBLCompactionCallback)(void *context,
+                                      CBLDatabase* db,
+                                      uint64_t bytesReclaimed,
+                                      const CBLCompactionStats *stats);
+
+/** Options for \ref CBLDatabase_StartAutoCompaction. */
+typedef struct {
+    double fragmentationThreshold;      ///< Free fraction of the file that triggers compaction (0 for default, 0.25)
+    uint64_t minFreeBytes;              ///< Minimum free bytes to trigger compaction (0 for default, 1MB)
+    uint32_t maxMillisPerStep;          ///< Max duration of a step (0 for default, 50ms)
+    uint32_t pauseMillis;               ///< Time to wait between steps, in ms
+    uint32_t checkIntervalSeconds;      ///< Time between checks of the file (0 for default, 60)
+    CBLCompactionCallback callback;     ///< Called after each step, or NULL
+    void *context;                      ///< Value passed to the callback
+} CBLAutoCompactionOptions;
+
+/** Starts a background thread that keeps the database file from accumulating free space,
+    without blocking the database for long like \ref CBLDatabase_Compact does.
+    It periodically checks the number of free pages in the file. When they exceed both the
+    `fragmentationThreshold` fraction of the file and `minFreeBytes`, it returns them to the
+    filesystem in small steps, each in its own transaction limited to `maxMillisPerStep`,
+    pausing between steps, until none are left.
+    @note  This only reclaims free pages; it doesn't do the other work of
+           \ref CBLDatabase_Compact, like deleting obsolete revisions and unused blobs.
+    The compactor is stopped when the database is closed.
+    @param db  The database.
+    @param options  The thresholds and limits, or NULL for the defaults.
+    @param error  On failure, the error will be written here.
+    @return  True if the compactor was started or was already running, false on error. */
+bool CBLDatabase_StartAutoCompaction(CBLDatabase* db _cbl_nonnull,
+                                     const CBLAutoCompactionOptions *options,
+                                     CBLError* error) CBLAPI;
+
+/** Stops the database's background compaction, if it's running. */
+void CBLDatabase_StopAutoCompaction(CBLDatabase* db _cbl_nonnull) CBLAPI;
+
+/** Returns statistics of the database's background compaction since it was started.
+    If it's never been started, all the values are zero. */
+CBLCompactionStats CBLDatabase_CompactionStats(const CBLDatabase* db _cbl_nonnull) CBLAPI;
+
+/** @} */
+
+
+
+#pragma mark - IMPORT
+/** \name  Bulk import
+    @{
+    Importing large numbers of documents from a file.
+ */
+
+/** Callback reporting the progress of \ref CBLDatabase_ImportJSONLines. It's called on the
+    importing thread after each batch of documents is committed.
+    @param context  The `context` value from the \ref CBLImportOptions.
+    @param linesRead  The number of input lines read so far.
+    @param docsSaved  The number of documents saved so far.
+    @return  True to continue importing, false to stop. */
+typedef bool (*CBLImportProgressCallback)(void *context,
+                                          uint64_t linesRead,
+                                          uint64_t docsSaved);
+
+/** Callback reporting an input line that couldn't be imported, either because it isn't a
+    JSON object or because the document couldn't be saved.
+    @param context  The `context` value from the \ref CBLImportOptions.
+    @param lineNumber  The (1-based) line number in the input file.
+    @param error  The error. */
+typedef void (*CBLImportErrorCallback)(void *context,
+                                       uint64_t lineNumber,
+                                       const CBLError* error _cbl_nonnull);
+
+/** Options for \ref CBLDatabase_ImportJSONLines. All fields may be left zero/NULL. */
+typedef struct {
+    const char *docIDProperty;          ///< Property holding the document ID (default "_id")
+    unsigned threadCount;               ///< Number of parser threads (default: number of CPUs)
+    unsigned batchSize;                 ///< Documents saved per transaction (default 1000)
+    CBLImportProgressCallback progress; ///< Called after every batch is saved
+    CBLImportErrorCallback error;       ///< Called for every line that can't be imported
+    void *context;                      ///< Value passed to the callbacks
+} CBLImportOptions;
+
+/** Imports documents from a file of newline-delimited JSON, one JSON object per line.
+    The lines are parsed on a pool of background threads, while the calling thread saves the
+    documents in large batches, each in a single transaction.
+
+    Each object becomes a document's properties. Its ID is taken from the property named by
+    `docIDProperty`; if that's missing, a unique ID is generated. An existing document with the
+    same ID is overwritten. Empty lines are skipped. Lines that can't be imported are reported
+    to the `error` callback, and don't stop the import.
+    @param db  The database to import into.
+    @param path  The filesystem path of the input file.
+    @param options  Import options, or NULL for the defaults.
+    @param error  On failure, the error will be written here.
+    @return  The number of documents saved, or -1 if the file couldn't be read or a transaction
+             couldn't be committed. Documents saved in earlier batches remain saved. */
+int64_t CBLDatabase_ImportJSONLines(CBLDatabase* db _cbl_nonnull,
+                                    const char *path _cbl_nonnull,
+                                    const CBLImportOptions *options,
+                                    CBLError* error) CBLAPI;
+
+/** @} */
+
+
+
+#pragma mark - BACKUP
+/** \name  Online backup
+    @{
+    Copying an open database while it's in use.
+ */
+
+/** Callback reporting the progress of \ref CBLDatabase_Backup. It's called on the calling
+    thread after each step.
+    @param context  The `context` value from the \ref CBLBackupOptions.
+    @param pagesCopied  The number of database pages copied so far.
+    @param totalPages  The total number of pages in the database snapshot being copied.
+    @return  True to continue, false to cancel the backup. */
+typedef bool (*CBLBackupProgressCallback)(void *context,
+                                          uint64_t pagesCopied,
+                                          uint64_t totalPages);
+
+/** Options for \ref CBLDatabase_Backup. All fields may be left zero/NULL. */
+typedef struct {
+    uint32_t pagesPerStep;              ///< Pages copied per step (default 1024)
+    CBLBackupProgressCallback progress; ///< Called after every step
+    void *context;                      ///< Value passed to the callback
+} CBLBackupOptions;
+
+/** Makes a consistent copy of an open database, without blocking writers.
+    The database file is copied from a snapshot, in steps of `pagesPerStep` pages, while other
+    connections continue to read and write. Blobs are copied too; ones already present in the
+    destination are skipped, since blobs never change.
+
+    The database file is written to a temporary file first and then moved into place, so if the
+    backup fails or is cancelled, a previous backup at the same path is left intact.
+
+    Every backup copies the whole database file, even if a previous backup exists at the same
+    path; only the blobs are copied incrementally. Updating just the changed pages would mean
+    either overwriting the previous backup in place, which a crash partway through would leave
+    corrupt, or copying it to a temporary file first, which costs as much I/O as a full copy.
+
+    The result is an ordinary database, which can be opened with \ref CBLDatabase_Open or
+    copied with \ref CBL_CopyDatabase.
+    @note  While the backup runs, the database's write-ahead log can't be checkpointed past
+           the snapshot, so it may grow.
+    @note  Encrypted databases can't be backed up this way.
+    @param db  The database to back up.
+    @param destPath  The filesystem path of the backup, including the ".cblite2" extension.
+                     The directory is created if it doesn't exist.
+    @param options  Backup options, or NULL for the defaults.
+    @param error  On failure, the error will be written here.
+    @return  True on success, false on failure or if the callback cancelled the backup. */
+bool CBLDatabase_Backup(CBLDatabase* db _cbl_nonnull,
+                        const char *destPath _cbl_nonnull,
+                        const CBLBackupOptions *options,
+                        CBLError* error) CBLAPI;
+
+/** @} */
+
+
+
+#pragma mark - SNAPSHOTS
+/** \name  Snapshots
+    @{
+    Reading a consistent view of a database while it's being changed.
+ */
+
+/** Begins a snapshot: a view of the database as of now, which doesn't change while other
+    threads or processes write to the database. Reads and queries made through the snapshot
+    (\ref CBLSnapshot_GetDocument, \ref CBLSnapshot_GetDocuments,
+    \ref CBLSnapshot_ExecuteQuery) all see that same state, so a report built from several of
+    them is consistent.
+    Unlike a batch, a snapshot doesn't block writers. It uses a read transaction on a separate
+    connection to the database file, so it doesn't see changes made in a batch that's still
+    open, either.
+    @note  You **must** call \ref CBLSnapshot_End when done. Until then, the database's
+           write-ahead log can't be checkpointed past the snapshot, so it may grow.
+    @param db  The database.
+    @param error  On failure, the error will be written here.
+    @return  The new snapshot, or NULL on failure. */
+_cbl_warn_unused
+CBLSnapshot* CBLDatabase_BeginSnapshot(CBLDatabase* db _cbl_nonnull,
+                                       CBLError* error) CBLAPI;
+
+/** Ends and frees a snapshot. Documents read from it remain valid. */
+void CBLSnapshot_End(CBLSnapshot*) CBLAPI;
+
+/** Reads a document as of the snapshot, in immutable form.
+    @note  You must release the document when you're done with it.
+    @param snapshot  The snapshot.
+    @param docID  The ID of the document.
+    @return  A new immutable document instance, or NULL if the document didn't exist. */
+_cbl_warn_unused
+const CBLDocument* CBLSnapshot_GetDocument(const CBLSnapshot* snapshot _cbl_nonnull,
+                                           const char* _cbl_nonnull docID) CBLAPI;
+
+/** Reads multiple documents as of the snapshot, like \ref CBLDatabase_GetDocuments.
+    @param snapshot  The snapshot.
+    @param docIDs  The IDs of the documents.
+    @param count  The number of document IDs.
+    @param outDocs  On return, the documents (or NULL if missing) in the same order as the IDs.
+                    You must release each non-NULL document.
+    @return  The number of documents that were found. */
+size_t CBLSnapshot_GetDocuments(const CBLSnapshot* snapshot _cbl_nonnull,
+                                const char* const docIDs[] _cbl_nonnull,
+                                size_t count,
+                                const CBLDocument* outDocs[] _cbl_nonnull) CBLAPI;
+
 /** @} */
 
 
@@ -179,6 +514,48 @@ uint64_t CBLDatabase_Count(const CBLDatabase* _cbl_nonnull) CBLAPI;
     @note  The encryption key is not filled in, for security reasons. */
 const CBLDatabaseConfiguration CBLDatabase_Config(const CBLDatabase* _cbl_nonnull) CBLAPI;
 
+/** Statistics of a database's document cache. */
+typedef struct {
+    uint64_t hits;                          ///< Number of lookups that found a cached document
+    uint64_t misses;                        ///< Number of lookups that had to read the document
+    uint64_t count;                         ///< Number of documents currently cached
+    uint64_t bytes;                         ///< Approximate memory used by the cached documents
+} CBLDocumentCacheStats;
+
+/** Returns statistics of the database's document cache. The cache is enabled by setting the
+    `documentCacheSize` field of the \ref CBLDatabaseConfiguration; it holds recently read
+    immutable documents, so that \ref CBLDatabase_GetDocument can return them without reading
+    the database file. Cached documents are evicted as soon as they're changed or purged.
+    If the cache is disabled, all the values are zero. */
+CBLDocumentCacheStats CBLDatabase_DocumentCacheStats(const CBLDatabase* _cbl_nonnull) CBLAPI;
+
+/** Storage statistics of a database, returned by \ref CBLDatabase_GetStats. */
+typedef struct {
+    uint64_t fileSize;                      ///< Size of the main database file, in bytes
+    uint64_t walSize;                       ///< Size of the write-ahead log file, in bytes
+    uint64_t pageSize;                      ///< Size of a page of the database file, in bytes
+    uint64_t pageCount;                     ///< Number of pages in the database file
+    uint64_t freePageCount;                 ///< Number of unused pages in the database file
+    uint64_t blobCount;                     ///< Number of blobs in the blob store
+    uint64_t blobsSize;                     ///< Total size of the blobs, in bytes
+    uint64_t indexCount;                    ///< Number of indexes created by the app
+    uint64_t indexesSize;                   ///< Total size of the indexes, or 0 if unavailable
+    uint64_t documentCount;                 ///< Number of (undeleted) documents
+    uint64_t averageDocumentSize;           ///< Average stored size of a document, with its history
+} CBLDatabaseStats;
+
+/** Gets statistics about the database's storage, for deciding when to compact it or how much
+    disk space to provision.
+    @note  This scans the blob store directory and the documents table, so it's not a cheap
+           call on a large database.
+    @param db  The database.
+    @param outStats  The statistics will be written here.
+    @param error  On failure, the error will be written here.
+    @return  True on success, false on error. */
+bool CBLDatabase_GetStats(const CBLDatabase* db _cbl_nonnull,
+                          CBLDatabaseStats *outStats _cbl_nonnull,
+                          CBLError* error) CBLAPI;
+
 /** @} */
 
 
@@ -217,6 +594,46 @@ CBLListenerToken* CBLDatabase_AddChangeListener(const CBLDatabase* db _cbl_nonnu
                                                 CBLDatabaseChangeListener listener _cbl_nonnull,
                                                 void *context) CBLAPI;
 
+/** A change to a document, as reported to a \ref CBLDatabaseRawChangeListener. */
+typedef struct {
+    FLSlice docID;              ///< The document's ID
+    uint64_t sequence;          ///< The document's new sequence
+    uint32_t bodySize;          ///< Size of the new revision's body in bytes
+    bool external;              ///< True if made by another CBLDatabase instance on the same file
+} CBLDatabaseChange;
+
+/** A lower-level database change listener callback, which is given the raw change records
+    instead of a list of docIDs. No memory is allocated to deliver them.
+    @warning  This listener is called synchronously, on the thread that committed the changes,
+              right after the commit; it is _not_ affected by \ref CBLDatabase_BufferNotifications.
+              It must return quickly, and must not make changes to the database. It may add or
+              remove listeners, though.
+    @param context  An arbitrary value given when the callback was registered.
+    @param db  The database that changed.
+    @param numChanges  The number of changes (size of the `changes` array.)
+    @param changes  The changes, in sequence order. The `docID`s are only valid until the
+                    callback returns. */
+typedef void (*CBLDatabaseRawChangeListener)(void *context,
+                                             const CBLDatabase* db _cbl_nonnull,
+                                             unsigned numChanges,
+                                             const CBLDatabaseChange changes[] _cbl_nonnull);
+
+/** Registers a raw database change listener callback. This is faster than a regular
+    \ref CBLDatabaseChangeListener, and it gets more information, but see the warning on
+    \ref CBLDatabaseRawChangeListener.
+    @param db  The database to observe.
+    @param listener  The callback to be invoked.
+    @param maxChanges  The maximum number of changes to pass to a single call, or 0 for the
+                       default (100). Larger batches mean fewer calls during bulk writes.
+    @param context  An opaque value that will be passed to the callback.
+    @return  A token to be passed to \ref CBLListener_Remove when it's time to remove the
+            listener.*/
+_cbl_warn_unused
+CBLListenerToken* CBLDatabase_AddRawChangeListener(const CBLDatabase* db _cbl_nonnull,
+                                                   CBLDatabaseRawChangeListener listener _cbl_nonnull,
+                                                   unsigned maxChanges,
+                                                   void *context) CBLAPI;
+
 /** @} */
 /** @} */    // end of outer \defgroup
 
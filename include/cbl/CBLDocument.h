@@ -52,6 +52,22 @@ _cbl_warn_unused
 const CBLDocument* CBLDatabase_GetDocument(const CBLDatabase* database _cbl_nonnull,
                                            const char* _cbl_nonnull docID) CBLAPI;
 
+/** Reads multiple documents from the database, creating a new (immutable) \ref CBLDocument
+    object for each one that exists. This is faster than calling \ref CBLDatabase_GetDocument
+    for each ID, since the documents are read together in storage order. Outside a batch, they
+    are all read in one read transaction, so they reflect the same commit.
+    @param database  The database.
+    @param docIDs  The IDs of the documents.
+    @param count  The number of IDs in `docIDs`.
+    @param outDocs  An array of `count` document pointers. On return, each element will be set
+                    to a new \ref CBLDocument instance, which must later be released, or to NULL
+                    if no document with that ID exists.
+    @return  The number of documents that were found. */
+size_t CBLDatabase_GetDocuments(const CBLDatabase* database _cbl_nonnull,
+                                const char* const docIDs[] _cbl_nonnull,
+                                size_t count,
+                                const CBLDocument* outDocs[] _cbl_nonnull) CBLAPI;
+
 CBL_REFCOUNTED(CBLDocument*, Document);
 
 /** Saves a (mutable) document to the database.
@@ -66,6 +82,63 @@ const CBLDocument* CBLDatabase_SaveDocument(CBLDatabase* db _cbl_nonnull,
                                             CBLConcurrencyControl concurrency,
                                             CBLError* error) CBLAPI;
 
+/** Saves multiple (mutable) documents to the database in a single transaction.
+    This is much faster than saving them one at a time, since the transaction is only
+    committed once.
+    A failure to save one document, such as a conflict, doesn't affect the others; its error is
+    reported in the corresponding element of `outErrors`.
+    @param db  The database to save to.
+    @param docs  The mutable documents to save.
+    @param count  The number of documents in `docs`.
+    @param concurrency  Conflict-handling strategy.
+    @param outErrors  An array of `count` errors, or NULL. On return, each element's `code` is
+                      zero if the corresponding document was saved, else nonzero.
+    @param error  On failure to commit the transaction, the error will be written here.
+    @return  True if the transaction was committed, false if it failed (in which case no
+             documents were saved.) */
+bool CBLDatabase_SaveDocuments(CBLDatabase* db _cbl_nonnull,
+                               CBLDocument* const docs[] _cbl_nonnull,
+                               size_t count,
+                               CBLConcurrencyControl concurrency,
+                               CBLError outErrors[],
+                               CBLError* error) CBLAPI;
+
+/** A callback that reports the result of \ref CBLDatabase_SaveDocumentAsync. It's called on the
+    database's writer thread, after the transaction containing the save has been committed
+    (or has failed.)
+    @param context  The value given to \ref CBLDatabase_SaveDocumentAsync.
+    @param savedDoc  An updated document reflecting the saved changes, or NULL on failure.
+                     It's released after the callback returns, so retain it if you need it.
+    @param error  The reason the save failed, or NULL if it succeeded. */
+typedef void (*CBLSaveCompletionCallback)(void *context,
+                                          const CBLDocument* savedDoc,
+                                          const CBLError* error);
+
+/** Queues a (mutable) document to be saved to the database asynchronously.
+    The database's writer thread collects queued saves from all threads and commits them together
+    in a single transaction, up to the limits given by the `saveGroupMaxDocs` and
+    `saveGroupMaxDelay` fields of the \ref CBLDatabaseConfiguration. This "group commit" is much
+    faster than many threads each saving documents with \ref CBLDatabase_SaveDocument, since
+    the cost of committing a transaction is shared by all the documents.
+    Each document's result, including a conflict, is reported to its own callback.
+    @warning  Don't modify the document until the callback has been called.
+    @note  Documents queued before \ref CBLDatabase_Close is called are saved before it returns.
+           If the database is released without being closed, they fail with an error.
+    @param db  The database to save to.
+    @param doc  The mutable document to save. It's retained until it's been saved.
+    @param concurrency  Conflict-handling strategy.
+    @param callback  The callback to invoke when the save has completed, or NULL.
+    @param context  An arbitrary value to be passed to the callback.
+    @param error  On failure to queue the document, the error will be written here.
+    @return  True if the document was queued, false if it couldn't be (for example if it's
+             immutable or the database is closed.) */
+bool CBLDatabase_SaveDocumentAsync(CBLDatabase* db _cbl_nonnull,
+                                   CBLDocument* doc _cbl_nonnull,
+                                   CBLConcurrencyControl concurrency,
+                                   CBLSaveCompletionCallback callback,
+                                   void *context,
+                                   CBLError* error) CBLAPI;
+
 /** Deletes a document from the database. Deletions are replicated.
     @warning  You are still responsible for releasing the CBLDocument.
     @param document  The document to delete.
@@ -100,6 +173,49 @@ bool CBLDatabase_PurgeDocumentByID(CBLDatabase* database _cbl_nonnull,
                                   const char* docID _cbl_nonnull,
                                   CBLError* error) CBLAPI;
 
+/** A callback that reports the progress of \ref CBLDatabase_DeleteDocumentsByID or
+    \ref CBLDatabase_PurgeDocumentsByID. It's called after each chunk of documents is committed.
+    @param context  The value given to the function.
+    @param docsProcessed  The number of document IDs processed so far.
+    @param docsRemoved  The number of documents deleted or purged so far.
+    @return  True to continue, false to stop before the next chunk. */
+typedef bool (*CBLBatchProgressCallback)(void *context,
+                                         size_t docsProcessed,
+                                         size_t docsRemoved);
+
+/** Deletes multiple documents, given their IDs. Deletions are replicated.
+    The documents are deleted in chunks of `chunkSize`, each in its own transaction, so that
+    other writers aren't blocked for long. IDs of documents that don't exist, or are already
+    deleted, are skipped.
+    @note  If an error occurs, or the operation is stopped by the progress callback, the chunks
+           already committed remain deleted.
+    @param database  The database.
+    @param docIDs  The IDs of the documents to delete.
+    @param count  The number of IDs in `docIDs`.
+    @param chunkSize  The maximum number of documents per transaction, or 0 for a default.
+    @param progress  A callback to report progress and allow cancelation, or NULL.
+    @param context  An arbitrary value to be passed to the progress callback.
+    @param error  On failure, the error will be written here.
+    @return  The number of documents deleted, or -1 on error. */
+int64_t CBLDatabase_DeleteDocumentsByID(CBLDatabase* database _cbl_nonnull,
+                                        const char* const docIDs[] _cbl_nonnull,
+                                        size_t count,
+                                        size_t chunkSize,
+                                        CBLBatchProgressCallback progress,
+                                        void *context,
+                                        CBLError* error) CBLAPI;
+
+/** Purges multiple documents, given their IDs. Purges are _not_ replicated.
+    This works like \ref CBLDatabase_DeleteDocumentsByID, except that the documents are purged.
+    @return  The number of documents purged, or -1 on error. */
+int64_t CBLDatabase_PurgeDocumentsByID(CBLDatabase* database _cbl_nonnull,
+                                       const char* const docIDs[] _cbl_nonnull,
+                                       size_t count,
+                                       size_t chunkSize,
+                                       CBLBatchProgressCallback progress,
+                                       void *context,
+                                       CBLError* error) CBLAPI;
+
 /** @} */
 
 
@@ -129,9 +245,11 @@ CBLDocument* CBLDocument_New(const char *docID) CBLAPI _cbl_warn_unused _cbl_ret
 /** Creates a new mutable CBLDocument instance that refers to the same document as the original.
     If the original document has unsaved changes, the new one will also start out with the same
     changes; but mutating one document thereafter will not affect the other.
-    @note  You must release the new reference when you're done with it. */
+    @note  You must release the new reference when you're done with it.
+    @return  The mutable copy, or NULL if the original came from an enumerator with the
+             `metadataOnly` option, since it has no properties to copy. */
 CBLDocument* CBLDocument_MutableCopy(const CBLDocument* original _cbl_nonnull) CBLAPI
-    _cbl_warn_unused _cbl_returns_nonnull;
+    _cbl_warn_unused;
 
 /** @} */
 
@@ -180,11 +298,78 @@ FLDoc CBLDocument_CreateFleeceDoc(const CBLDocument* _cbl_nonnull) CBLAPI;
     @note You are responsible for calling `free()` on the returned string. */
 char* CBLDocument_PropertiesAsJSON(const CBLDocument* _cbl_nonnull) CBLAPI _cbl_returns_nonnull; 
 
+/** Returns a document's properties as JSON, in a heap-allocated slice. Unlike
+    \ref CBLDocument_PropertiesAsJSON, this doesn't need to copy the JSON to add a null terminator.
+    @note You are responsible for calling \ref FLSliceResult_Release on the returned slice. */
+FLSliceResult CBLDocument_PropertiesToJSON(const CBLDocument* _cbl_nonnull) CBLAPI;
+
+/** A callback that receives JSON data written by \ref CBLDocument_WritePropertiesJSON.
+    @param context  The `context` value given to \ref CBLDocument_WritePropertiesJSON.
+    @param bytes  The JSON data. It's only valid until the callback returns.
+    @param size  The number of bytes of data.
+    @return  True on success, false if the data couldn't be written. */
+typedef bool (*CBLJSONWriter)(void *context, const void *bytes, size_t size);
+
+/** Writes a document's properties as JSON to a callback, such as one that appends it to an
+    output buffer or stream. The JSON is generated in full first, then passed to the callback
+    in a single call; this saves the copy that \ref CBLDocument_PropertiesAsJSON makes to add a
+    null terminator, but the whole JSON is still held in memory.
+    @param doc  The document.
+    @param writer  The callback that writes the data. It's called exactly once.
+    @param context  An arbitrary value that will be passed to the callback.
+    @return  True on success, false if the callback returned false. */
+bool CBLDocument_WritePropertiesJSON(const CBLDocument* doc _cbl_nonnull,
+                                     CBLJSONWriter writer _cbl_nonnull,
+                                     void *context) CBLAPI;
+
 /** Sets a mutable document's properties from a JSON string. */
 bool CBLDocument_SetPropertiesAsJSON(CBLDocument* _cbl_nonnull,
                                      const char *json _cbl_nonnull,
                                      CBLError*) CBLAPI;
 
+/** Flags describing the state of a document. */
+typedef CBL_OPTIONS(uint32_t, CBLDocumentFlags) {
+    kCBLDocumentFlagsDeleted         = 0x01,    ///< The current revision is a deletion
+    kCBLDocumentFlagsConflicted      = 0x02,    ///< The document is in conflict
+    kCBLDocumentFlagsHasAttachments  = 0x04,    ///< The document has blobs
+    kCBLDocumentFlagsExists          = 0x1000,  ///< The document exists in the database
+};
+
+/** Metadata about a document, obtained without reading its properties. */
+typedef struct {
+    FLString docID;                 ///< The document ID
+    uint64_t sequence;              ///< The current sequence; see \ref CBLDocument_Sequence
+    CBLDocumentFlags flags;         ///< Flags describing the document's state
+    uint64_t bodySize;              ///< Size of the stored body in bytes, or 0 if not requested
+    time_t expiration;              ///< Expiration time, or 0 if none or not requested
+} CBLDocumentInfo;
+
+/** Optional fields of \ref CBLDocumentInfo. Each one takes an extra read to look up. */
+typedef CBL_OPTIONS(uint32_t, CBLDocumentInfoFields) {
+    kCBLDocumentInfoBodySize   = 0x01,  ///< Look up `bodySize`
+    kCBLDocumentInfoExpiration = 0x02,  ///< Look up `expiration`
+};
+
+/** Looks up a document's metadata, without reading or decoding its body. This is much
+    cheaper than \ref CBLDatabase_GetDocument when you only need to know whether a document
+    exists, or what its sequence is; that takes a single lookup. The `bodySize` and
+    `expiration` take another read each, so they're only looked up if requested in `fields`;
+    all the reads then see the same commit.
+    @note  The `docID` field points to the `docID` parameter's characters.
+    @note  If no document with that ID exists, this function will return false but the error
+            code will be zero.
+    @param db  The database.
+    @param docID  The ID of the document.
+    @param fields  The optional fields to look up, or 0 for none.
+    @param outInfo  On success, the document's metadata will be written here.
+    @param error  On failure, an error is written here.
+    @return  True if the document exists, false if not or on failure. */
+bool CBLDatabase_GetDocumentInfo(const CBLDatabase* db _cbl_nonnull,
+                                 const char *docID _cbl_nonnull,
+                                 CBLDocumentInfoFields fields,
+                                 CBLDocumentInfo *outInfo _cbl_nonnull,
+                                 CBLError* error) CBLAPI;
+
 /** Returns the time, if any, at which a given document will expire and be purged.
     Documents don't normally expire; you have to call \ref CBLDatabase_SetDocumentExpiration
     to set a document's expiration time.
@@ -216,6 +401,131 @@ bool CBLDatabase_SetDocumentExpiration(CBLDatabase* db _cbl_nonnull,
 
 
 
+/** \name  Document enumeration
+    @{
+    Iterating over all documents, or the ones changed since a sequence, without a query.
+ */
+
+/** Options for \ref CBLDatabase_EnumerateDocuments. All fields may be left zero/NULL. */
+typedef struct {
+    const char *startDocID;     ///< First docID to return (inclusive), or NULL
+    const char *endDocID;       ///< Last docID to return (inclusive), or NULL
+    uint64_t sinceSequence;     ///< If nonzero, only docs changed after this sequence
+    bool descending;            ///< Return docs in descending order
+    bool includeDeleted;        ///< Include deleted documents (tombstones)
+    bool metadataOnly;          ///< Don't read bodies; the docs' properties are empty, and they can't be copied
+} CBLEnumeratorOptions;
+
+/** An iterator over documents, created by \ref CBLDatabase_EnumerateDocuments. */
+typedef struct CBLDocumentEnumerator CBLDocumentEnumerator;
+
+/** Starts enumerating documents, which are then returned in batches by
+    \ref CBLDocumentEnumerator_Next. This is much faster than a query that returns the same
+    documents, since there's nothing to compile and no rows to decode.
+
+    Documents are returned in docID order, unless `sinceSequence` is nonzero, in which case only
+    the ones changed after that sequence are returned, in sequence order. `startDocID` and
+    `endDocID` follow the order: if `descending` is true, `startDocID` should be the greater.
+    With `sinceSequence` they still filter the docIDs, but the whole sequence range is scanned.
+    @note  `startDocID` doesn't seek: the enumeration starts at the first document and skips
+           the ones before `startDocID`, so it takes O(N) time in the number of documents
+           preceding it. (`endDocID` does stop the enumeration early.)
+
+    The enumerator sees the database as of when it was created, as with
+    \ref CBLDatabase_BeginSnapshot, except during a batch, when it sees the batch's changes.
+    @param db  The database.
+    @param options  Enumeration options, or NULL for the defaults.
+    @param error  On failure, the error will be written here.
+    @return  A new enumerator, or NULL on failure. You must free it with
+             \ref CBLDocumentEnumerator_Free. */
+_cbl_warn_unused
+CBLDocumentEnumerator* CBLDatabase_EnumerateDocuments(const CBLDatabase* db _cbl_nonnull,
+                                                      const CBLEnumeratorOptions *options,
+                                                      CBLError* error) CBLAPI;
+
+/** Returns the next batch of documents from an enumerator.
+    @param e  The enumerator.
+    @param outDocs  On return, the documents. You must release each one.
+    @param maxDocs  The maximum number of documents to return (the size of `outDocs`).
+    @param error  On failure, the error will be written here.
+    @return  The number of documents returned, which is only less than `maxDocs` at the end.
+             Returns 0 at the end, or on failure, in which case `error->code` is nonzero. */
+size_t CBLDocumentEnumerator_Next(CBLDocumentEnumerator* e _cbl_nonnull,
+                                  const CBLDocument* outDocs[] _cbl_nonnull,
+                                  size_t maxDocs,
+                                  CBLError* error) CBLAPI;
+
+/** Frees an enumerator. */
+void CBLDocumentEnumerator_Free(CBLDocumentEnumerator*) CBLAPI;
+
+/** @} */
+
+
+
+/** \name  Changes feed
+    @{
+    Pulling the changes made since a sequence, in batches. A consumer that remembers the last
+    sequence it processed can resume where it left off, even after the app restarts, without
+    rescanning the database. The sequence can be persisted with
+    \ref CBLDatabase_SetChangesCursor.
+ */
+
+/** A batch of changes returned by \ref CBLDatabase_GetChangesSince. */
+typedef struct {
+    const CBLDocumentInfo *changes; ///< The changed documents, in sequence order
+    size_t count;                   ///< The number of items in `changes`
+    uint64_t lastSequence;          ///< The sequence to pass as `since` to get the next batch
+} CBLChanges;
+
+/** Returns the documents changed since a sequence, in sequence order, using the database's
+    sequence index. Each document appears only once, with its current sequence; deleted
+    documents are included, with the \ref kCBLDocumentFlagsDeleted flag. Only metadata is
+    returned; document bodies are not read. (`expiration` is always 0.)
+
+    To follow the feed, pass the batch's `lastSequence` as `since` in the next call. A batch
+    with fewer than `limit` changes means the consumer has caught up.
+    @param db  The database.
+    @param since  Only documents whose sequence is greater than this are returned. Use 0 to
+                  start from the beginning.
+    @param limit  The maximum number of changes to return, or 0 for no limit.
+    @param error  On failure, the error will be written here.
+    @return  A new batch of changes, which must be freed with \ref CBLChanges_Free,
+             or NULL on failure. */
+_cbl_warn_unused
+CBLChanges* CBLDatabase_GetChangesSince(const CBLDatabase* db _cbl_nonnull,
+                                        uint64_t since,
+                                        size_t limit,
+                                        CBLError* error) CBLAPI;
+
+/** Frees a batch of changes returned by \ref CBLDatabase_GetChangesSince. */
+void CBLChanges_Free(CBLChanges*) CBLAPI;
+
+/** Durably saves a consumer's position in the changes feed, under a name of its choosing.
+    The cursor is stored in the database file, outside of any document, so it doesn't itself
+    appear in the feed or replicate.
+    @param db  The database.
+    @param name  The name of the cursor; typically identifies the consumer.
+    @param sequence  The last sequence the consumer has processed.
+    @param error  On failure, the error will be written here.
+    @return  True on success, false on failure. */
+bool CBLDatabase_SetChangesCursor(CBLDatabase* db _cbl_nonnull,
+                                  const char *name _cbl_nonnull,
+                                  uint64_t sequence,
+                                  CBLError* error) CBLAPI;
+
+/** Returns a sequence saved by \ref CBLDatabase_SetChangesCursor, or 0 if there is none.
+    @param db  The database.
+    @param name  The name of the cursor.
+    @param error  On failure, the error will be written here. (A missing cursor is not an error.)
+    @return  The saved sequence, or 0 if none was saved or on failure. */
+uint64_t CBLDatabase_GetChangesCursor(const CBLDatabase* db _cbl_nonnull,
+                                      const char *name _cbl_nonnull,
+                                      CBLError* error) CBLAPI;
+
+/** @} */
+
+
+
 /** \name  Document listeners
     @{
     A document change listener lets you detect changes made to a specific document after they
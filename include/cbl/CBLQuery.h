@@ -107,6 +107,15 @@ bool CBLQuery_SetParametersAsJSON(CBLQuery* _cbl_nonnull query,
 _cbl_warn_unused
 CBLResultSet* CBLQuery_Execute(CBLQuery* _cbl_nonnull, CBLError*) CBLAPI;
 
+/** Runs the query against a snapshot of its database (see \ref CBLDatabase_BeginSnapshot),
+    returning the results as they were when the snapshot began.
+    @note  The query must have been created on the same \ref CBLDatabase as the snapshot.
+    @note  You must release the result set when you're finished with it. */
+_cbl_warn_unused
+CBLResultSet* CBLSnapshot_ExecuteQuery(const CBLSnapshot* _cbl_nonnull,
+                                       CBLQuery* _cbl_nonnull,
+                                       CBLError*) CBLAPI;
+
 /** Returns information about the query, including the translated SQLite form, and the search
     strategy. You can use this to help optimize the query: the word `SCAN` in the strategy
     indicates a linear scan of the entire database, which should be avoided by adding an index.
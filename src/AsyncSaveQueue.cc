@@ -0,0 +1,152 @@
+//
+// AsyncSaveQueue.cc
+//
+// Copyright (c) 2019 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "AsyncSaveQueue.hh"
+#include "CBLDocument_Internal.hh"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+using namespace std;
+using namespace fleece;
+
+namespace cbl_internal {
+
+    struct AsyncSaveQueue::State {
+        // A queued save
+        struct Item {
+            CBLDocument::SaveRequest            request;
+            CBLSaveCompletionCallback           callback;
+            void*                               context;
+            chrono::steady_clock::time_point    time;       // When it was queued
+        };
+
+        CBLDatabase* const      db;
+        C4Database* const       writer;
+        size_t const            maxGroupSize;
+        chrono::microseconds    maxDelay;
+
+        mutex                   queueMutex;
+        condition_variable      cond;
+        deque<Item>             queue;
+        bool                    stopping;
+        bool                    flush;
+    };
+
+
+    AsyncSaveQueue::AsyncSaveQueue(CBLDatabase *db,
+                                   C4Database *writer,
+                                   unsigned maxGroupSize,
+                                   unsigned maxDelayMicros)
+    :_state(new State{db, writer, max(maxGroupSize, 1u), chrono::microseconds(maxDelayMicros)})
+    ,_thread(run, _state)
+    { }
+
+
+    AsyncSaveQueue::~AsyncSaveQueue() {
+        stop(false);
+    }
+
+
+    void AsyncSaveQueue::add(CBLDocument *doc,
+                             CBLConcurrencyControl concurrency,
+                             CBLSaveCompletionCallback callback,
+                             void *context)
+    {
+        {
+            lock_guard<mutex> lock(_state->queueMutex);
+            _state->queue.push_back({{doc, concurrency}, callback, context,
+                                     chrono::steady_clock::now()});
+        }
+        _state->cond.notify_one();
+    }
+
+
+    void AsyncSaveQueue::stop(bool flush) {
+        if (!_thread.joinable())
+            return;
+        {
+            lock_guard<mutex> lock(_state->queueMutex);
+            _state->stopping = true;
+            _state->flush = flush;
+        }
+        _state->cond.notify_one();
+        if (this_thread::get_id() == _thread.get_id())
+            _thread.detach();       // Called from a completion callback, via ~CBLDatabase
+        else
+            _thread.join();
+    }
+
+
+    // The writer thread's main loop.
+    void AsyncSaveQueue::run(shared_ptr<State> state) {
+        while (true) {
+            vector<State::Item> group;
+            bool cancel;
+            {
+                unique_lock<mutex> lock(state->queueMutex);
+                state->cond.wait(lock, [&]{ return state->stopping || !state->queue.empty(); });
+                if (state->queue.empty())
+                    break;
+                // Give other threads a chance to add more documents to the group:
+                auto deadline = state->queue.front().time + state->maxDelay;
+                state->cond.wait_until(lock, deadline, [&]{
+                    return state->stopping || state->queue.size() >= state->maxGroupSize;
+                });
+                cancel = state->stopping && !state->flush;
+                size_t n = cancel ? state->queue.size()
+                                  : min(state->queue.size(), state->maxGroupSize);
+                group.reserve(n);
+                for (size_t i = 0; i < n; ++i) {
+                    group.push_back(move(state->queue.front()));
+                    state->queue.pop_front();
+                }
+            }
+
+            C4Error error = {};
+            if (cancel) {
+                setError(&error, LiteCoreDomain, kC4ErrorNotOpen, "Database was closed"_sl);
+            } else {
+                vector<CBLDocument::SaveRequest> requests;
+                requests.reserve(group.size());
+                for (auto &item : group)
+                    requests.push_back(move(item.request));
+                CBLDocument::saveGroup(state->db, state->writer, requests.data(), requests.size(),
+                                       &error);
+                for (size_t i = 0; i < group.size(); ++i)
+                    group[i].request = move(requests[i]);
+            }
+
+            // Report the results. (If the commit failed, every document gets its error.)
+            for (auto &item : group) {
+                auto &rq = item.request;
+                if (!rq.savedDoc && rq.error.code == 0)
+                    rq.error = error;
+                if (item.callback)
+                    item.callback(item.context, rq.savedDoc, (rq.savedDoc ? nullptr
+                                                                          : external(&rq.error)));
+            }
+        }
+
+        c4db_close(state->writer, nullptr);
+        c4db_release(state->writer);
+    }
+
+}
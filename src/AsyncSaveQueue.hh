@@ -0,0 +1,63 @@
+//
+// AsyncSaveQueue.hh
+//
+// Copyright (c) 2019 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLDocument.h"
+#include "Internal.hh"
+#include <memory>
+#include <thread>
+
+struct CBLDatabase;
+
+
+namespace cbl_internal {
+
+    /** Implements CBLDatabase_SaveDocumentAsync. A writer thread with its own C4Database handle
+        takes documents from a queue and saves them in groups, one transaction per group.
+        Owned by CBLDatabase. */
+    class AsyncSaveQueue {
+    public:
+        /** Takes ownership of the C4Database handle `writer`, which must be on the same file
+            as the database's own handle. */
+        AsyncSaveQueue(CBLDatabase* _cbl_nonnull,
+                       C4Database* writer _cbl_nonnull,
+                       unsigned maxGroupSize,
+                       unsigned maxDelayMicros);
+        ~AsyncSaveQueue();
+
+        /** Queues a document to be saved. */
+        void add(CBLDocument* _cbl_nonnull,
+                 CBLConcurrencyControl,
+                 CBLSaveCompletionCallback,
+                 void *context);
+
+        /** Stops the writer thread. If `flush` is true, the queued documents are saved first;
+            otherwise they fail with a kC4ErrorNotOpen error. */
+        void stop(bool flush);
+
+    private:
+        struct State;
+        static void run(std::shared_ptr<State>);
+
+        // (The State is shared with the writer thread, so it can outlive this object if the
+        // database is freed by a completion callback on the writer thread.)
+        std::shared_ptr<State> _state;
+        std::thread _thread;
+    };
+
+}
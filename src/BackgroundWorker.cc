@@ -0,0 +1,78 @@
+//
+// BackgroundWorker.cc
+//
+// Copyright (c) 2019 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "BackgroundWorker.hh"
+
+using namespace std;
+
+namespace cbl_internal {
+
+    BackgroundWorker::~BackgroundWorker() {
+        assert(!_thread.joinable());    // Subclass's owner must call stop() first
+    }
+
+
+    void BackgroundWorker::start(C4Database *c4db) {
+        assert(!_c4db);
+        _c4db = c4db;
+        _thread = thread([this]{ run(); });
+    }
+
+
+    void BackgroundWorker::wake() {
+        {
+            lock_guard<mutex> lock(_mutex);
+            _woken = true;
+        }
+        _cond.notify_one();
+    }
+
+
+    void BackgroundWorker::stop() {
+        {
+            lock_guard<mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _cond.notify_one();
+        if (_thread.joinable())
+            _thread.join();
+    }
+
+
+    bool BackgroundWorker::stopping() const {
+        lock_guard<mutex> lock(_mutex);
+        return _stopping;
+    }
+
+
+    void BackgroundWorker::run() {
+        unique_lock<mutex> lock(_mutex);
+        while (!_stopping) {
+            _woken = false;
+            lock.unlock();
+            clock::time_point next = runTask(_c4db);
+            lock.lock();
+            _cond.wait_until(lock, next, [&]{ return _stopping || _woken; });
+        }
+        lock.unlock();
+        willClose(_c4db);
+        c4db_close(_c4db, nullptr);
+        c4db_release(_c4db);
+    }
+
+}
@@ -0,0 +1,74 @@
+//
+// BackgroundWorker.hh
+//
+// Copyright (c) 2019 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "Internal.hh"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+
+namespace cbl_internal {
+
+    /** Abstract base class of database maintenance tasks that run periodically on a background
+        thread, using their own C4Database handle so they don't interfere with the app's
+        transactions. Subclasses implement `runTask`.
+        The owner must call `stop` before destroying the object. */
+    class BackgroundWorker {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        virtual ~BackgroundWorker();
+
+        /** Starts the thread, which will first call `runTask` immediately. Takes ownership of
+            the C4Database handle, which is closed when the thread stops. */
+        void start(C4Database* _cbl_nonnull);
+
+        /** Makes the thread call `runTask` as soon as possible. */
+        void wake();
+
+        /** Stops the thread, waiting for the current `runTask` call to return. */
+        void stop();
+
+        /** True if the thread has been started and not stopped. */
+        bool running() const                    {return _thread.joinable();}
+
+    protected:
+        /** Does some work, then returns the time at which it should be called again. */
+        virtual clock::time_point runTask(C4Database* _cbl_nonnull) =0;
+
+        /** Called on the thread just before it closes its C4Database handle. Subclasses must
+            release any objects they created with the handle, such as compiled queries. */
+        virtual void willClose(C4Database* _cbl_nonnull)      { }
+
+        /** True if `stop` has been called; a long-running `runTask` should check this. */
+        bool stopping() const;
+
+    private:
+        void run();
+
+        C4Database*             _c4db {nullptr};
+        std::thread             _thread;
+        mutable std::mutex      _mutex;
+        std::condition_variable _cond;
+        bool                    _woken {false};
+        bool                    _stopping {false};
+    };
+
+}
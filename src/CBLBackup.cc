@@ -0,0 +1,208 @@
+//
+// CBLBackup.cc
+//
+// Copyright (c) 2019 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "CBLDatabase_Internal.hh"
+#include "Internal.hh"
+#include "Util.hh"
+#include "sqlite3.h"
+#include <chrono>
+#include <errno.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+
+using namespace std;
+using namespace fleece;
+using namespace cbl_internal;
+
+
+namespace {
+
+    static constexpr uint32_t kDefaultPagesPerStep = 1024;
+
+    // How long to wait before retrying a step that found the source or destination locked:
+    static constexpr auto kBusyRetryDelay = chrono::milliseconds(10);
+
+
+    bool sqliteError(sqlite3 *sqlite, int rc, C4Error *outError) {
+        setError(outError, SQLiteDomain, rc, slice(sqlite ? sqlite3_errmsg(sqlite)
+                                                          : sqlite3_errstr(rc)));
+        return false;
+    }
+
+
+    bool posixError(const char *message, C4Error *outError) {
+        setError(outError, POSIXDomain, errno, slice(message));
+        return false;
+    }
+
+
+    // An open SQLite connection that's closed when it goes out of scope.
+    class Connection {
+    public:
+        bool open(const string &path, int flags, C4Error *outError) {
+            int rc = sqlite3_open_v2(path.c_str(), &_sqlite, flags, nullptr);
+            if (rc != SQLITE_OK)
+                return sqliteError(_sqlite, rc, outError);
+            sqlite3_busy_timeout(_sqlite, 5000);
+            return true;
+        }
+
+        bool exec(const char *sql, C4Error *outError) {
+            int rc = sqlite3_exec(_sqlite, sql, nullptr, nullptr, nullptr);
+            return (rc == SQLITE_OK) || sqliteError(_sqlite, rc, outError);
+        }
+
+        ~Connection()                       {sqlite3_close_v2(_sqlite);}
+        operator sqlite3*() const           {return _sqlite;}
+
+    private:
+        sqlite3* _sqlite {nullptr};
+    };
+
+
+    // Copies the database file `srcPath` to `destPath`, from a snapshot, with the SQLite
+    // online backup API.
+    bool copySnapshot(const string &srcPath, const string &destPath,
+                      const CBLBackupOptions &options, C4Error *outError)
+    {
+        Connection src, dest;
+        if (!src.open(srcPath, SQLITE_OPEN_READONLY, outError)
+                || !dest.open(destPath, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, outError))
+            return false;
+
+        // Keep a read transaction open on the source for the whole backup. Otherwise every
+        // commit by another connection between steps would make the backup start over; this
+        // way the steps all read the same snapshot, while other connections keep writing.
+        if (!src.exec("BEGIN; SELECT count(*) FROM sqlite_master", outError))
+            return false;
+
+        sqlite3_backup *backup = sqlite3_backup_init(dest, "main", src, "main");
+        if (!backup)
+            return sqliteError(dest, sqlite3_errcode(dest), outError);
+        int rc;
+        bool cancelled = false;
+        do {
+            rc = sqlite3_backup_step(backup, int(options.pagesPerStep));
+            if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+                this_thread::sleep_for(kBusyRetryDelay);
+            } else if (options.progress) {
+                int total = sqlite3_backup_pagecount(backup);
+                int remaining = sqlite3_backup_remaining(backup);
+                cancelled = !options.progress(options.context, total - remaining, total);
+            }
+        } while ((rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED) && !cancelled);
+        sqlite3_backup_finish(backup);
+        src.exec("COMMIT", nullptr);
+
+        if (cancelled) {
+            setError(outError, POSIXDomain, ECANCELED, "Backup was cancelled"_sl);
+            return false;
+        } else if (rc != SQLITE_DONE) {
+            return sqliteError(dest, rc, outError);
+        }
+        return true;
+    }
+
+
+    bool copyFile(const string &srcPath, const string &destPath) {
+        FILE *src = fopen(srcPath.c_str(), "rb");
+        if (!src)
+            return false;
+        string tempPath = destPath + ".tmp";
+        FILE *dest = fopen(tempPath.c_str(), "wb");
+        if (!dest) {
+            fclose(src);
+            return false;
+        }
+        char buf[32768];
+        size_t n;
+        bool ok = true;
+        while (ok && (n = fread(buf, 1, sizeof(buf), src)) > 0)
+            ok = (fwrite(buf, 1, n, dest) == n);
+        ok = ok && !ferror(src);
+        fclose(src);
+        if (fclose(dest) != 0)
+            ok = false;
+        // Write to a temporary file first, so a partial copy is never mistaken for a blob:
+        ok = ok && rename(tempPath.c_str(), destPath.c_str()) == 0;
+        if (!ok)
+            remove(tempPath.c_str());
+        return ok;
+    }
+
+
+    // Copies the blob files that aren't in the destination yet.
+    bool copyBlobs(const string &srcDir, const string &destDir, C4Error *outError) {
+        if (!fileExists(srcDir))
+            return true;        // No blobs
+        if (!makeDirectory(destDir))
+            return posixError("Couldn't create backup blob directory", outError);
+        bool ok = true;
+        bool readable = forEachFile(srcDir, [&](const char *name, uint64_t) {
+            string destPath = destDir + "/" + name;
+            if (ok && !fileExists(destPath) && !copyFile(srcDir + "/" + name, destPath))
+                ok = posixError("Couldn't copy blob", outError);
+        });
+        return ok && (readable || posixError("Couldn't read blob directory", outError));
+    }
+
+}
+
+
+bool CBLDatabase_Backup(CBLDatabase* db,
+                        const char *destPath,
+                        const CBLBackupOptions *inOptions,
+                        CBLError* outError) CBLAPI
+{
+    C4Error *c4err = internal(outError);
+    // (`db->config` doesn't have the encryption key, so ask LiteCore.)
+    if (c4db_getConfig2(internal(db))->encryptionKey.algorithm != kC4EncryptionNone) {
+        setError(c4err, LiteCoreDomain, kC4ErrorUnsupported,
+                 "Encrypted databases can't be backed up"_sl);
+        return false;
+    }
+    CBLBackupOptions options = inOptions ? *inOptions : CBLBackupOptions{};
+    if (options.pagesPerStep == 0)
+        options.pagesPerStep = kDefaultPagesPerStep;
+
+    string destDir = destPath;
+    if (!destDir.empty() && destDir.back() != '/')
+        destDir += '/';
+    if (!makeDirectory(destDir))
+        return posixError("Couldn't create backup directory", c4err);
+    string srcFile = db->filePath(kSQLiteFileName);
+    string destFile = destDir + kSQLiteFileName;
+
+    // Copy into a temporary file, so a failed or cancelled backup leaves any previous one intact:
+    string tempFile = destFile + ".tmp";
+    remove(tempFile.c_str());
+    if (!copySnapshot(srcFile, tempFile, options, c4err)) {
+        remove(tempFile.c_str());
+        return false;
+    }
+    // A leftover WAL from opening the previous backup doesn't match the new file:
+    remove((destFile + "-wal").c_str());
+    remove((destFile + "-shm").c_str());
+    if (!replaceFile(tempFile, destFile)) {
+        posixError("Couldn't replace previous backup", c4err);
+        remove(tempFile.c_str());
+        return false;
+    }
+    return copyBlobs(db->filePath(kBlobsDirName), destDir + kBlobsDirName, c4err);
+}
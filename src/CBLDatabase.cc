@@ -21,7 +21,9 @@
 #include "Internal.hh"
 #include "Util.hh"
 #include "PlatformCompat.hh"
+#include "c4Private.h"
 #include <sys/stat.h>
+#include <algorithm>
 
 #ifndef CMAKE
 #include <unistd.h>
@@ -102,22 +104,131 @@ CBLDatabase* CBLDatabase_Open(const char *name,
     C4Database *c4db = c4db_openNamed(slice(name), &c4config, internal(outError));
     if (!c4db)
         return nullptr;
-    return retain(new CBLDatabase(c4db, name,
-                                  c4config.parentDirectory,
-                                  (config ? config->flags : kDefaultFlags)));
+    CBLDatabaseConfiguration defaultConfig = {nullptr, kDefaultFlags};
+    auto db = retained(new CBLDatabase(c4db, name,
+                                       c4config.parentDirectory,
+                                       (config ? *config : defaultConfig)));
+    if (!db->applyTuning(c4db, internal(outError))
+            || !db->openReaders(c4config, internal(outError)))
+        return nullptr;
+    return retain(db.get());
+}
+
+
+bool CBLDatabase::applyTuning(C4Database *handle, C4Error *outError) const {
+    static const char* const kSynchronous[] = {nullptr, "FULL", "NORMAL", "OFF"};
+
+    const CBLStorageTuning &tuning = config.tuning;
+    vector<string> pragmas;
+    if (tuning.pageCacheSize > 0)
+        pragmas.push_back("cache_size=-" + to_string(tuning.pageCacheSize));   // (negative: KB)
+    if (tuning.mmapSize != 0)
+        pragmas.push_back("mmap_size=" + to_string(max(tuning.mmapSize, int64_t(0))));
+    if (tuning.durability != kCBLDurabilityDefault) {
+        if (tuning.durability > kCBLDurabilityOff) {
+            setError(outError, LiteCoreDomain, kC4ErrorInvalidParameter,
+                     "Invalid durability level"_sl);
+            return false;
+        }
+        pragmas.push_back(string("synchronous=") + kSynchronous[tuning.durability]);
+    }
+    if (tuning.walAutoCheckpoint != 0)
+        pragmas.push_back("wal_autocheckpoint=" + to_string(max(tuning.walAutoCheckpoint, 0)));
+    if (tuning.journalSizeLimit != 0)
+        pragmas.push_back("journal_size_limit=" + to_string(max(tuning.journalSizeLimit,
+                                                                 int64_t(-1))));
+
+    for (auto &pragma : pragmas) {
+        alloc_slice result(c4db_rawQuery(handle, slice("PRAGMA " + pragma), outError));
+        if (!result)
+            return false;
+    }
+    return true;
+}
+
+
+C4Database* CBLDatabase::openConnection(C4Error *outError) const {
+    C4Database *handle = c4db_openAgain(c4db, outError);
+    if (handle && !applyTuning(handle, outError)) {
+        c4db_close(handle, nullptr);
+        c4db_release(handle);
+        handle = nullptr;
+    }
+    return handle;
+}
+
+
+bool CBLDatabase::openReaders(C4DatabaseConfig2 c4config, C4Error *outError) {
+    c4config.flags = (c4config.flags & ~kC4DB_Create) | kC4DB_ReadOnly;
+    _readerTransactionMutexes.reset(new mutex[config.readerCount]);
+    for (uint32_t i = 0; i < config.readerCount; ++i) {
+        C4Database *reader = c4db_openNamed(slice(name), &c4config, outError);
+        if (!reader)
+            return false;
+        _readers.push_back(reader);
+        if (!applyTuning(reader, outError))
+            return false;
+    }
+    return true;
+}
+
+
+void CBLDatabase::registerQuery(CBLQuery *query) const {
+    lock_guard<mutex> lock(_queriesMutex);
+    _queries.insert(query);
+}
+
+
+void CBLDatabase::unregisterQuery(CBLQuery *query) const {
+    lock_guard<mutex> lock(_queriesMutex);
+    _queries.erase(query);
+}
+
+
+void CBLDatabase::closeOtherConnections() {
+    stopAsyncSaves(true);
+    stopExpirationScheduler();
+    stopAutoCompaction();
+    {
+        lock_guard<mutex> lock(_queriesMutex);
+        for (CBLQuery *query : _queries)
+            releaseOtherQueries(query);
+    }
+    for (C4Database *reader : _readers)
+        c4db_close(reader, nullptr);
+    lock_guard<mutex> lock(_snapshotMutex);
+    for (C4Database *conn : _snapshotConnections)
+        c4db_close(conn, nullptr);
 }
 
 
 bool CBLDatabase_Close(CBLDatabase* db, CBLError* outError) CBLAPI {
-    return !db || c4db_close(internal(db), internal(outError));
+    if (!db)
+        return true;
+    db->closeOtherConnections();
+    if (!c4db_close(internal(db), internal(outError)))
+        return false;
+    if (auto cache = db->documentCache())
+        cache->clear();             // Cached docs retain the database
+    return true;
 }
 
 bool CBLDatabase_BeginBatch(CBLDatabase* db, CBLError* outError) CBLAPI {
-    return c4db_beginTransaction(internal(db), internal(outError));
+    return db->beginBatch(internal(outError));
+}
+
+bool CBLDatabase_BeginAutoBatch(CBLDatabase* db,
+                                uint64_t maxDocs,
+                                uint64_t maxBytes,
+                                CBLBatchChunkCallback callback,
+                                void *context,
+                                CBLError* outError) CBLAPI
+{
+    return db->beginAutoBatch(maxDocs, maxBytes, callback, context, internal(outError));
 }
 
 bool CBLDatabase_EndBatch(CBLDatabase* db, CBLError* outError) CBLAPI {
-    return c4db_endTransaction(internal(db), true, internal(outError));
+    return db->endBatch(internal(outError));
 }
 
 bool CBLDatabase_Compact(CBLDatabase* db, CBLError* outError) CBLAPI {
@@ -125,7 +236,12 @@ bool CBLDatabase_Compact(CBLDatabase* db, CBLError* outError) CBLAPI {
 }
 
 bool CBLDatabase_Delete(CBLDatabase* db, CBLError* outError) CBLAPI {
-    return c4db_delete(internal(db), internal(outError));
+    db->closeOtherConnections();
+    if (!c4db_delete(internal(db), internal(outError)))
+        return false;
+    if (auto cache = db->documentCache())
+        cache->clear();
+    return true;
 }
 
 time_t CBLDatabase_NextDocExpiration(CBLDatabase* db) CBLAPI {
@@ -137,6 +253,337 @@ int64_t CBLDatabase_PurgeExpiredDocuments(CBLDatabase* db, CBLError* outError) C
 }
 
 
+#pragma mark - BATCHES:
+
+
+bool CBLDatabase::beginBatch(C4Error *outError) {
+    lock_guard<mutex> lock(_batchMutex);
+    if (!c4db_beginTransaction(c4db, outError))
+        return false;
+    ++_batchDepth;
+    return true;
+}
+
+
+bool CBLDatabase::beginAutoBatch(uint64_t maxDocs, uint64_t maxBytes,
+                                 CBLBatchChunkCallback callback, void *context,
+                                 C4Error *outError)
+{
+    lock_guard<mutex> lock(_batchMutex);
+    if (!c4db_beginTransaction(c4db, outError))
+        return false;
+    if (++_batchDepth == 1)
+        _autoBatch.reset(new AutoBatch{maxDocs, maxBytes, callback, context, 0, 0, {}});
+    return true;
+}
+
+
+bool CBLDatabase::endBatch(C4Error *outError) {
+    unique_ptr<AutoBatch> finished;
+    bool ok;
+    {
+        lock_guard<mutex> lock(_batchMutex);
+        if (_batchDepth == 1 && _autoBatch && _autoBatch->error.code) {
+            // A chunk failed to commit, which already ended the batch's transaction:
+            if (outError)
+                *outError = _autoBatch->error;
+            ok = false;
+        } else {
+            ok = c4db_endTransaction(c4db, true, outError);
+        }
+        if (_batchDepth > 0 && --_batchDepth == 0)
+            finished = move(_autoBatch);
+    }
+    if (ok && finished && finished->callback)
+        finished->callback(finished->context, this, finished->docs, finished->bytes);
+    return ok;
+}
+
+
+bool CBLDatabase::documentsSaved(size_t count, uint64_t bytes, C4Error *outError) {
+    AutoBatch chunk;
+    {
+        lock_guard<mutex> lock(_batchMutex);
+        if (!_autoBatch || _autoBatch->error.code)
+            return true;
+        AutoBatch &batch = *_autoBatch;
+        batch.docs += count;
+        batch.bytes += bytes;
+        // Only commit a chunk if the auto-batch is the only transaction open:
+        if (_batchDepth != 1 || !((batch.maxDocs > 0 && batch.docs >= batch.maxDocs)
+                    || (batch.maxBytes > 0 && batch.bytes >= batch.maxBytes)))
+            return true;
+
+        C4Error error;
+        bool committed;
+        if (_failNextChunkCommit.exchange(false)) {
+            c4db_endTransaction(c4db, false, nullptr);
+            error = {LiteCoreDomain, kC4ErrorIOError};
+            committed = false;
+        } else {
+            committed = c4db_endTransaction(c4db, true, &error);
+        }
+        if (!committed || !c4db_beginTransaction(c4db, &error)) {
+            // The batch is broken. Make sure no transaction is left open, and remember the error
+            // so that endBatch reports it too. Later saves in the batch commit on their own.
+            C4LogToAt(kC4DatabaseLog, kC4LogWarning, "Auto-batch failed to %s: %d/%d",
+                      (committed ? "begin a transaction" : "commit"), error.domain, error.code);
+            if (c4db_isInTransaction(c4db))
+                c4db_endTransaction(c4db, false, nullptr);
+            batch.error = error;
+            if (outError)
+                *outError = error;
+            return false;
+        }
+        chunk = batch;
+        batch.docs = batch.bytes = 0;
+    }
+    if (chunk.callback)
+        chunk.callback(chunk.context, this, chunk.docs, chunk.bytes);
+    return true;
+}
+
+
+#pragma mark - ASYNC SAVES:
+
+
+static constexpr unsigned kDefaultSaveGroupMaxDocs = 1000;
+
+
+bool CBLDatabase::saveDocumentAsync(CBLDocument *doc,
+                                    CBLConcurrencyControl concurrency,
+                                    CBLSaveCompletionCallback callback,
+                                    void *context,
+                                    C4Error *outError)
+{
+    lock_guard<mutex> lock(_asyncSaveMutex);
+    if (!_asyncSaveQueue) {
+        // The writer thread gets its own connection, so its transactions are isolated:
+        C4Database *writer = openConnection(outError);
+        if (!writer)
+            return false;
+        unsigned maxDocs = config.saveGroupMaxDocs ? config.saveGroupMaxDocs
+                                                   : kDefaultSaveGroupMaxDocs;
+        _asyncSaveQueue.reset(new AsyncSaveQueue(this, writer, maxDocs, config.saveGroupMaxDelay));
+    }
+    _asyncSaveQueue->add(doc, concurrency, callback, context);
+    return true;
+}
+
+
+void CBLDatabase::stopAsyncSaves(bool flush) {
+    unique_ptr<AsyncSaveQueue> queue;
+    {
+        lock_guard<mutex> lock(_asyncSaveMutex);
+        queue = move(_asyncSaveQueue);
+    }
+    if (queue)
+        queue->stop(flush);
+}
+
+
+#pragma mark - EXPIRATION SCHEDULER:
+
+
+bool CBLDatabase::startExpirationScheduler(const CBLExpirationSchedulerOptions *options,
+                                           C4Error *outError)
+{
+    lock_guard<mutex> lock(_expirationMutex);
+    if (_expirationScheduler && _expirationScheduler->running())
+        return true;
+    C4Database *handle = openConnection(outError);
+    if (!handle)
+        return false;
+    _expirationScheduler.reset(new ExpirationScheduler(options));
+    _expirationScheduler->start(handle);
+    return true;
+}
+
+
+void CBLDatabase::stopExpirationScheduler() {
+    lock_guard<mutex> lock(_expirationMutex);
+    if (_expirationScheduler)
+        _expirationScheduler->stop();       // (keep it around for its stats)
+}
+
+
+void CBLDatabase::expirationChanged() {
+    lock_guard<mutex> lock(_expirationMutex);
+    if (_expirationScheduler && _expirationScheduler->running())
+        _expirationScheduler->wake();
+}
+
+
+CBLExpirationStats CBLDatabase::expirationStats() const {
+    lock_guard<mutex> lock(_expirationMutex);
+    if (_expirationScheduler)
+        return _expirationScheduler->stats();
+    return {};
+}
+
+
+bool CBLDatabase_StartExpirationScheduler(CBLDatabase* db,
+                                          const CBLExpirationSchedulerOptions *options,
+                                          CBLError* outError) CBLAPI
+{
+    return db->startExpirationScheduler(options, internal(outError));
+}
+
+void CBLDatabase_StopExpirationScheduler(CBLDatabase* db) CBLAPI {
+    db->stopExpirationScheduler();
+}
+
+CBLExpirationStats CBLDatabase_ExpirationStats(const CBLDatabase* db) CBLAPI {
+    return db->expirationStats();
+}
+
+
+#pragma mark - SNAPSHOTS:
+
+
+bool CBLDatabase::withReadTransaction(function<void(C4Database*)> fn, C4Error *outError) {
+    int i = pickReader();
+    if (i < 0) {
+        if (c4db_isInTransaction(c4db)) {
+            fn(c4db);               // The batch's transaction already covers the reads
+            return true;
+        }
+        // No readers, and the main connection's transactions belong to LiteCore:
+        C4Database *conn = beginSnapshot(outError);
+        if (!conn)
+            return false;
+        fn(conn);
+        endSnapshot(conn);
+        return true;
+    }
+
+    // Other threads may be reading on the same reader meanwhile; that's harmless, since their
+    // reads just see this transaction's snapshot. But only one of them can begin a transaction.
+    C4Database *conn = _readers[i];
+    lock_guard<mutex> lock(_readerTransactionMutexes[i]);
+    alloc_slice begun(c4db_rawQuery(conn, "BEGIN"_sl, outError));
+    if (!begun)
+        return false;
+    fn(conn);
+    C4Error error;
+    alloc_slice ended(c4db_rawQuery(conn, "COMMIT"_sl, &error));
+    if (!ended)
+        C4LogToAt(kC4DatabaseLog, kC4LogWarning,
+                  "Couldn't end read transaction: %d/%d", error.domain, error.code);
+    return true;
+}
+
+
+
+C4Database* CBLDatabase::beginSnapshot(C4Error *outError) {
+    C4Database *conn = nullptr;
+    {
+        lock_guard<mutex> lock(_snapshotMutex);
+        if (!_idleSnapshotConnections.empty()) {
+            conn = _idleSnapshotConnections.back();
+            _idleSnapshotConnections.pop_back();
+        }
+    }
+    if (!conn) {
+        conn = openConnection(outError);
+        if (!conn)
+            return nullptr;
+        lock_guard<mutex> lock(_snapshotMutex);
+        _snapshotConnections.push_back(conn);
+    }
+
+    // A deferred transaction only takes its snapshot at its first read, so read something now:
+    alloc_slice begun(c4db_rawQuery(conn, "BEGIN"_sl, outError));
+    if (begun) {
+        alloc_slice read(c4db_rawQuery(conn, "SELECT count(*) FROM sqlite_master"_sl, outError));
+        if (read)
+            return conn;
+        endSnapshot(conn);
+    } else {
+        lock_guard<mutex> lock(_snapshotMutex);
+        _idleSnapshotConnections.push_back(conn);
+    }
+    return nullptr;
+}
+
+
+void CBLDatabase::endSnapshot(C4Database *conn) {
+    // (The connection is kept open, instead of closed, since documents read from it may refer
+    // to it. They're all closed when the database is.)
+    C4Error error;
+    alloc_slice ended(c4db_rawQuery(conn, "COMMIT"_sl, &error));
+    if (!ended)
+        C4LogToAt(kC4DatabaseLog, kC4LogWarning,
+                  "Couldn't end snapshot: %d/%d", error.domain, error.code);
+    lock_guard<mutex> lock(_snapshotMutex);
+    _idleSnapshotConnections.push_back(conn);
+}
+
+
+CBLSnapshot* CBLDatabase_BeginSnapshot(CBLDatabase* db, CBLError* outError) CBLAPI {
+    C4Database *conn = db->beginSnapshot(internal(outError));
+    if (!conn)
+        return nullptr;
+    return new CBLSnapshot{db, conn};
+}
+
+void CBLSnapshot_End(CBLSnapshot* snapshot) CBLAPI {
+    if (!snapshot)
+        return;
+    snapshot->db->endSnapshot(snapshot->c4db);
+    delete snapshot;
+}
+
+
+#pragma mark - AUTO COMPACTION:
+
+
+bool CBLDatabase::startAutoCompaction(const CBLAutoCompactionOptions *options,
+                                      C4Error *outError)
+{
+    lock_guard<mutex> lock(_compactorMutex);
+    if (_compactor && _compactor->running())
+        return true;
+    C4Database *handle = openConnection(outError);
+    if (!handle)
+        return false;
+    _compactor.reset(new Compactor(this, options));
+    _compactor->start(handle);
+    return true;
+}
+
+
+void CBLDatabase::stopAutoCompaction() {
+    lock_guard<mutex> lock(_compactorMutex);
+    if (_compactor)
+        _compactor->stop();                 // (keep it around for its stats)
+}
+
+
+CBLCompactionStats CBLDatabase::compactionStats() const {
+    lock_guard<mutex> lock(_compactorMutex);
+    if (_compactor)
+        return _compactor->stats();
+    return {};
+}
+
+
+bool CBLDatabase_StartAutoCompaction(CBLDatabase* db,
+                                     const CBLAutoCompactionOptions *options,
+                                     CBLError* outError) CBLAPI
+{
+    return db->startAutoCompaction(options, internal(outError));
+}
+
+void CBLDatabase_StopAutoCompaction(CBLDatabase* db) CBLAPI {
+    db->stopAutoCompaction();
+}
+
+CBLCompactionStats CBLDatabase_CompactionStats(const CBLDatabase* db) CBLAPI {
+    return db->compactionStats();
+}
+
+
 #pragma mark - ACCESSORS:
 
 
@@ -150,7 +597,15 @@ const char* CBLDatabase_Path(const CBLDatabase* db) CBLAPI {
 
 const CBLDatabaseConfiguration CBLDatabase_Config(const CBLDatabase* db) CBLAPI {
     const char *dir = db->dir.empty() ? nullptr : db->dir.c_str();
-    return {dir, db->flags};
+    CBLDatabaseConfiguration config = db->config;
+    config.directory = dir;
+    return config;
+}
+
+CBLDocumentCacheStats CBLDatabase_DocumentCacheStats(const CBLDatabase* db) CBLAPI {
+    if (auto cache = db->documentCache())
+        return cache->stats();
+    return {};
 }
 
 uint64_t CBLDatabase_Count(const CBLDatabase* db) CBLAPI {
@@ -161,6 +616,127 @@ uint64_t CBLDatabase_LastSequence(const CBLDatabase* db) CBLAPI {
     return c4db_getLastSequence(internal(db));
 }
 
+void CBLDatabase_FailNextChunkCommit(CBLDatabase* db) CBLAPI {
+    db->failNextChunkCommit();
+}
+
+bool CBLDatabase_GetPragma(const CBLDatabase* db, int reader, const char *pragma,
+                           int64_t *outValue) CBLAPI
+{
+    if (reader >= int(db->readerCount()))
+        return false;
+    Doc result(alloc_slice(c4db_rawQuery(db->reader(reader), slice(string("PRAGMA ") + pragma),
+                                         nullptr)));
+    if (!result)
+        return false;
+    *outValue = result.asArray()[0].asArray()[0].asInt();
+    return true;
+}
+
+
+#pragma mark - STATISTICS:
+
+
+// Returns the size of a file, or 0 if it doesn't exist.
+static uint64_t fileSize(const string &path) {
+    uint64_t size;
+    return getFileSize(path, size) ? size : 0;
+}
+
+
+// Runs a SQL query that returns a single number.
+static bool rawQueryNumber(C4Database *c4db, const string &sql, uint64_t &value,
+                           C4Error *outError)
+{
+    Doc doc(alloc_slice(c4db_rawQuery(c4db, slice(sql), outError)));
+    if (!doc)
+        return false;
+    value = doc.asArray()[0].asArray()[0].asUnsigned();
+    return true;
+}
+
+
+static string sqlQuote(slice str) {
+    string result = "'";
+    for (char c : string(str)) {
+        result += c;
+        if (c == '\'')
+            result += c;
+    }
+    return result + "'";
+}
+
+
+bool CBLDatabase_GetStats(const CBLDatabase* db,
+                          CBLDatabaseStats *outStats,
+                          CBLError* outError) CBLAPI
+{
+    C4Database *c4db = db->reader(db->pickReader());
+    C4Error *c4err = internal(outError);
+    CBLDatabaseStats stats = {};
+
+    Compactor::PageCounts pages;
+    if (!Compactor::getPageCounts(c4db, pages, c4err))
+        return false;
+    stats.pageSize = pages.pageSize;
+    stats.pageCount = pages.pageCount;
+    stats.freePageCount = pages.freePages;
+    stats.fileSize = pages.pageSize * pages.pageCount;
+
+    // SQLite names the WAL after the database file, whose path it reports as column 2:
+    Doc databases(alloc_slice(c4db_rawQuery(c4db, "PRAGMA database_list"_sl, c4err)));
+    if (!databases)
+        return false;
+    string sqlitePath(databases.asArray()[0].asArray()[2].asString());
+    stats.walSize = fileSize(sqlitePath + "-wal");
+
+    forEachFile(db->filePath(kBlobsDirName), [&](const char*, uint64_t size) {
+        ++stats.blobCount;
+        stats.blobsSize += size;
+    });
+
+    stats.documentCount = c4db_getDocumentCount(c4db);
+    if (stats.documentCount > 0) {
+        // Only the metadata is read; the enumerator reports each document's stored size:
+        C4EnumeratorOptions c4opts = kC4DefaultEnumeratorOptions;
+        c4opts.flags &= ~kC4IncludeBodies;
+        c4::ref<C4DocEnumerator> e = c4db_enumerateAllDocs(c4db, &c4opts, c4err);
+        if (!e)
+            return false;
+        uint64_t count = 0, totalSize = 0;
+        C4DocumentInfo info;
+        C4Error error = {};
+        while (c4enum_next(e, &error)) {
+            c4enum_getDocumentInfo(e, &info);
+            ++count;
+            totalSize += info.bodySize;
+        }
+        if (error.code != 0) {
+            if (c4err) *c4err = error;
+            return false;
+        }
+        stats.averageDocumentSize = count ? totalSize / count : 0;
+    }
+
+    Doc indexes(alloc_slice(c4db_getIndexes(c4db, c4err)));
+    if (!indexes)
+        return false;
+    for (Array::iterator i(indexes.asArray()); i; ++i) {
+        ++stats.indexCount;
+        // The dbstat table is only available if SQLite was built with SQLITE_ENABLE_DBSTAT_VTAB,
+        // so failure isn't an error:
+        uint64_t size;
+        C4Error err;
+        if (rawQueryNumber(c4db, "SELECT coalesce(sum(pgsize), 0) FROM dbstat WHERE name="
+                                     + sqlQuote(i.value().asString()),
+                           size, &err))
+            stats.indexesSize += size;
+    }
+
+    *outStats = stats;
+    return true;
+}
+
 
 #pragma mark - NOTIFICATIONS:
 
@@ -180,8 +756,70 @@ void CBLDatabase_SendNotifications(CBLDatabase *db) CBLAPI {
 #pragma mark - DATABASE CHANGE LISTENERS:
 
 
+static const uint32_t kMaxChanges = 100;
+
+
+namespace cbl_internal {
+
+    // Custom subclass of CBLListenerToken for raw database listeners, which remembers the
+    // listener's batch size.
+    template<>
+    class ListenerToken<CBLDatabaseRawChangeListener> : public CBLListenerToken {
+    public:
+        ListenerToken(CBLDatabaseRawChangeListener callback, void *context, unsigned maxChanges)
+        :CBLListenerToken((const void*)callback, context)
+        ,_maxChanges(maxChanges)
+        { }
+
+        CBLDatabaseRawChangeListener callback() const {
+            return (CBLDatabaseRawChangeListener)_callback.load();
+        }
+
+        unsigned maxChanges() const     {return _maxChanges;}
+
+        // Calls the listener with up to _maxChanges changes at a time:
+        void call(const CBLDatabase *db, unsigned nChanges, const CBLDatabaseChange changes[]) {
+            Call c(this);
+            for (unsigned start = 0; start < nChanges; start += _maxChanges) {
+                auto cb = callback();   // (reloaded each time, in case the listener removed itself)
+                if (!cb)
+                    break;
+                cb(_context, db, min(nChanges - start, _maxChanges), &changes[start]);
+            }
+        }
+
+    private:
+        unsigned const _maxChanges;
+    };
+
+}
+
+
 CBLListenerToken* CBLDatabase::addListener(CBLDatabaseChangeListener listener, void *context) {
     auto token = _listeners.add(listener, context);
+    startObserving();
+    return token;
+}
+
+
+CBLListenerToken* CBLDatabase::addRawListener(CBLDatabaseRawChangeListener listener,
+                                              unsigned maxChanges, void *context)
+{
+    if (maxChanges == 0)
+        maxChanges = kMaxChanges;
+    auto token = new ListenerToken<CBLDatabaseRawChangeListener>(listener, context, maxChanges);
+    // Grow the change buffers to hold the largest batch any raw listener wants. (This only
+    // records the size; databaseChanged resizes the buffers, since a callback may be using them.)
+    unsigned maxSoFar = _maxRawChanges;
+    while (maxChanges > maxSoFar && !_maxRawChanges.compare_exchange_weak(maxSoFar, maxChanges))
+        ;
+    _rawListeners.add(token);
+    startObserving();
+    return token;
+}
+
+
+void CBLDatabase::startObserving() {
     if (!_observer) {
         _observer = c4dbobs_create(c4db,
                                    [](C4DatabaseObserver* observer, void *context) {
@@ -189,39 +827,84 @@ CBLListenerToken* CBLDatabase::addListener(CBLDatabaseChangeListener listener, v
                                    },
                                    this);
     }
-    return token;
 }
 
 
+// Called by the C4DatabaseObserver as soon as a transaction is committed. The changes are read
+// right away, so the document cache is up to date even if notifications are being buffered.
+// Raw listeners are called here, with the changes in the reusable `_changes` buffer; regular
+// listeners are an adapter that collects the docIDs for a later call to `callDBListeners`.
+// Listeners are called without `_changesMutex` held, so they can add or remove listeners.
 void CBLDatabase::databaseChanged() {
-    notify(bind(&CBLDatabase::callDBListeners, this));
+    bool notifyListeners = false;
+    vector<Retained<CBLListenerToken>> docListeners;
+    {
+        lock_guard<mutex> observerLock(_observerMutex);
+        size_t bufferSize = max(kMaxChanges, _maxRawChanges.load());
+        if (_c4changes.size() < bufferSize) {
+            _c4changes.resize(bufferSize);
+            _changes.resize(bufferSize);
+        }
+        bool external;
+        uint32_t nChanges;
+        while (0 < (nChanges = c4dbobs_getChanges(_observer, _c4changes.data(),
+                                                  uint32_t(_c4changes.size()), &external))) {
+            for (uint32_t i = 0; i < nChanges; ++i) {
+                auto &c4change = _c4changes[i];
+                _changes[i] = {c4change.docID, c4change.sequence, c4change.bodySize, external};
+            }
+            {
+                lock_guard<mutex> lock(_changesMutex);
+                bool hadChanges = !_changedDocIDs.empty();
+                collectChanges(nChanges, _changes.data(), docListeners);
+                if (!hadChanges && !_changedDocIDs.empty())
+                    notifyListeners = true;
+            }
+            _rawListeners.call(this, unsigned(nChanges), _changes.data());
+        }
+    }
+    if (notifyListeners)
+        notify(bind(&CBLDatabase::callDBListeners, this));
+    for (auto &token : docListeners)
+        notify(token);
 }
 
 
-void CBLDatabase::callDBListeners() {
-    static const uint32_t kMaxChanges = 100;
-    while (true) {
-        C4DatabaseChange c4changes[kMaxChanges];
-        bool external;
-        uint32_t nChanges = c4dbobs_getChanges(_observer, c4changes, kMaxChanges, &external);
-        if (nChanges == 0)
-            break;
-        // Convert docID slices to C strings:
-        const char* docIDs[kMaxChanges];
-        size_t bufSize = 0;
-        for (uint32_t i = 0; i < nChanges; ++i)
-            bufSize += c4changes[i].docID.size + 1;
-        char *buf = new char[bufSize], *next = buf;
-        for (uint32_t i = 0; i < nChanges; ++i) {
-            docIDs[i] = next;
-            memcpy(next, (const char*)c4changes[i].docID.buf, c4changes[i].docID.size);
-            next += c4changes[i].docID.size;
-            *(next++) = '\0';
+// Handles changes on behalf of the document cache and the regular listeners. Document listeners
+// on the changed docIDs are added to `docListeners`, to be notified after the lock is released.
+void CBLDatabase::collectChanges(unsigned nChanges, const CBLDatabaseChange changes[],
+                                 vector<Retained<CBLListenerToken>> &docListeners)
+{
+    bool haveListeners = !_listeners.empty();
+    bool haveDocListeners = !_docListenerIndex.empty();
+    for (unsigned i = 0; i < nChanges; ++i) {
+        if (_documentCache)
+            _documentCache->remove(changes[i].docID);
+        if (haveListeners)
+            _changedDocIDs.emplace_back(slice(changes[i].docID));
+        if (haveDocListeners) {
+            auto entry = _docListenerIndex.find(changes[i].docID);
+            if (entry != _docListenerIndex.end())
+                docListeners.insert(docListeners.end(),
+                                    entry->second.tokens.begin(), entry->second.tokens.end());
         }
-        assert(next - buf == bufSize);
-        // Call the listener(s):
+    }
+}
+
+
+void CBLDatabase::callDBListeners() {
+    vector<string> changedDocIDs;
+    {
+        lock_guard<mutex> lock(_changesMutex);
+        swap(changedDocIDs, _changedDocIDs);
+    }
+    // Call the listener(s) with up to kMaxChanges docIDs at a time:
+    const char* docIDs[kMaxChanges];
+    for (size_t start = 0; start < changedDocIDs.size(); start += kMaxChanges) {
+        auto nChanges = unsigned(min(changedDocIDs.size() - start, size_t(kMaxChanges)));
+        for (unsigned i = 0; i < nChanges; ++i)
+            docIDs[i] = changedDocIDs[start + i].c_str();
         _listeners.call(this, nChanges, docIDs);
-        delete [] buf;
     }
 }
 
@@ -233,6 +916,14 @@ CBLListenerToken* CBLDatabase_AddChangeListener(const CBLDatabase* constdb _cbl_
     return const_cast<CBLDatabase*>(constdb)->addListener(listener, context);
 }
 
+CBLListenerToken* CBLDatabase_AddRawChangeListener(const CBLDatabase* constdb _cbl_nonnull,
+                                                   CBLDatabaseRawChangeListener listener _cbl_nonnull,
+                                                   unsigned maxChanges,
+                                                   void *context) CBLAPI
+{
+    return const_cast<CBLDatabase*>(constdb)->addRawListener(listener, maxChanges, context);
+}
+
 
 #pragma mark - DOCUMENT LISTENERS:
 
@@ -241,6 +932,8 @@ namespace cbl_internal {
 
     // Custom subclass of CBLListenerToken for document listeners.
     // (It implements the ListenerToken<> template so that it will work with Listeners<>.)
+    // Rather than each having its own C4DocumentObserver, these are indexed by docID in the
+    // CBLDatabase, whose single database observer notifies the ones whose documents changed.
     template<>
     class ListenerToken<CBLDocumentChangeListener> : public CBLListenerToken {
     public:
@@ -248,39 +941,27 @@ namespace cbl_internal {
         :CBLListenerToken((const void*)callback, context)
         ,_db(db)
         ,_docID(docID)
-        ,_c4obs( c4docobs_create(internal(db),
-                                 slice(docID),
-                                 [](C4DocumentObserver* observer, C4String docID,
-                                    C4SequenceNumber sequence, void *context)
-                                 {
-                                     ((ListenerToken*)context)->docChanged();
-                                 },
-                                 this) )
         { }
 
-        ~ListenerToken() {
-            c4docobs_free(_c4obs);
-        }
-
         CBLDocumentChangeListener callback() const {
             return (CBLDocumentChangeListener)_callback.load();
         }
 
         // this is called indirectly by CBLDatabase::sendNotifications
-        void call(const CBLDatabase*, const char*) {
-            auto cb = callback();
-            if (cb)
-                cb(_context, _db, _docID.c_str());
+        void notify() override {
+            Call c(this);
+            if (c.callback())
+                ((CBLDocumentChangeListener)c.callback())(_context, _db, _docID.c_str());
         }
 
-    private:
-        void docChanged() {
-            _db->notify(this, nullptr, nullptr);
+        void remove() override {
+            _db->removeDocListener(this, slice(_docID));
+            CBLListenerToken::remove();
         }
 
+    private:
         CBLDatabase* _db;
         string _docID;
-        C4DocumentObserver* _c4obs {nullptr};
     };
 
 }
@@ -291,10 +972,35 @@ CBLListenerToken* CBLDatabase::addDocListener(const char* docID _cbl_nonnull,
 {
     auto token = new ListenerToken<CBLDocumentChangeListener>(this, docID, listener, context);
     _docListeners.add(token);
+    {
+        lock_guard<mutex> lock(_changesMutex);
+        auto entry = _docListenerIndex.find(slice(docID));
+        if (entry == _docListenerIndex.end()) {
+            alloc_slice key(docID);
+            entry = _docListenerIndex.emplace(key, DocListeners{key, {}}).first;
+        }
+        entry->second.tokens.emplace_back(token);
+    }
+    startObserving();
     return token;
 }
 
 
+void CBLDatabase::removeDocListener(CBLListenerToken *token, slice docID) {
+    lock_guard<mutex> lock(_changesMutex);
+    auto entry = _docListenerIndex.find(docID);
+    if (entry == _docListenerIndex.end())
+        return;
+    auto &tokens = entry->second.tokens;
+    auto i = find_if(tokens.begin(), tokens.end(),
+                     [&](const Retained<CBLListenerToken> &t) {return t.get() == token;});
+    if (i != tokens.end())
+        tokens.erase(i);
+    if (tokens.empty())
+        _docListenerIndex.erase(entry);
+}
+
+
 CBLListenerToken* CBLDatabase_AddDocumentChangeListener(const CBLDatabase* db _cbl_nonnull,
                                              const char* docID _cbl_nonnull,
                                              CBLDocumentChangeListener listener _cbl_nonnull,
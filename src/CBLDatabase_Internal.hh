@@ -19,9 +19,24 @@
 #pragma once
 #include "CBLDatabase.h"
 #include "CBLDocument.h"
+#include "AsyncSaveQueue.hh"
+#include "Compactor.hh"
+#include "DocumentCache.hh"
+#include "ExpirationScheduler.hh"
 #include "Internal.hh"
 #include "Listener.hh"
 #include "access_lock.hh"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+// Names of LiteCore's files within a database directory:
+static const char* const kSQLiteFileName = "db.sqlite3";
+static const char* const kBlobsDirName = "Attachments";
 
 
 struct CBLDatabase : public CBLRefCounted {
@@ -29,18 +44,31 @@ struct CBLDatabase : public CBLRefCounted {
     CBLDatabase(C4Database* _cbl_nonnull db,
                 const std::string &name_,
                 fleece::slice dir_,
-                CBLDatabaseFlags flags_)
+                const CBLDatabaseConfiguration &config_)
     :c4db(db)
     ,name(name_)
     ,path(fleece::alloc_slice(c4db_getPath(c4db)))
     ,dir(dir_)
-    ,flags(flags_)
+    ,config(withoutSecrets(config_))
     ,_notificationQueue(this)
-    { }
+    {
+        if (config.documentCacheSize > 0) {
+            _documentCache.reset(new cbl_internal::DocumentCache(size_t(config.documentCacheSize)));
+            startObserving();
+        }
+    }
 
     virtual ~CBLDatabase() {
+        stopAsyncSaves(false);
+        stopExpirationScheduler();
+        stopAutoCompaction();
         c4dbobs_free(_observer);
         _docListeners.clear();
+        _docListenerIndex.clear();
+        for (C4Database *reader : _readers)
+            c4db_release(reader);
+        for (C4Database *conn : _snapshotConnections)
+            c4db_release(conn);
         c4db_release(c4db);
     }
 
@@ -48,11 +76,14 @@ struct CBLDatabase : public CBLRefCounted {
     std::string const name;         // Cached copy so API can return a C string
     std::string const path;         // Cached copy so API can return a C string
     std::string const dir;          // Cached copy so API can return a C string
-    CBLDatabaseFlags const flags;
+    CBLDatabaseConfiguration const config;  // (without the directory or encryption key)
 
     CBLListenerToken* addListener(CBLDatabaseChangeListener listener _cbl_nonnull, void *context);
+    CBLListenerToken* addRawListener(CBLDatabaseRawChangeListener listener _cbl_nonnull,
+                                     unsigned maxChanges, void *context);
     CBLListenerToken* addDocListener(const char *docID _cbl_nonnull,
                                      CBLDocumentChangeListener listener _cbl_nonnull, void *context);
+    void removeDocListener(CBLListenerToken* _cbl_nonnull, fleece::slice docID);
 
     void notify(Notification n) const   {const_cast<CBLDatabase*>(this)->_notificationQueue.add(n);}
     void sendNotifications()            {_notificationQueue.notifyAll();}
@@ -61,28 +92,172 @@ struct CBLDatabase : public CBLRefCounted {
         _notificationQueue.setCallback(callback, context);
     }
 
-    template <class LISTENER, class... Args>
-    void notify(ListenerToken<LISTENER> *listener, Args... args) const {
-        fleece::Retained<ListenerToken<LISTENER>> retained = listener;
-        notify([=]() {
-            retained->call(args...);
-        });
+    /** Schedules a call to the token's `notify` method. If one is already pending, nothing
+        happens, so a listener notified many times between SendNotifications calls runs once. */
+    void notify(CBLListenerToken *listener _cbl_nonnull) const {
+        const_cast<CBLDatabase*>(this)->_notificationQueue.add(listener);
     }
 
     C4BlobStore* blobStore() const                      {return c4db_getBlobStore(c4db, nullptr);}
 
+    bool beginBatch(C4Error *outError);
+    bool beginAutoBatch(uint64_t maxDocs, uint64_t maxBytes,
+                        CBLBatchChunkCallback, void *context,
+                        C4Error *outError);
+    bool endBatch(C4Error *outError);
+
+    // Must be called after documents are saved or deleted, once their own transaction has
+    // committed. Lets an auto-batch commit a chunk. Returns false if that commit failed, in
+    // which case the chunk's changes were lost and the save must fail.
+    bool documentsSaved(size_t count, uint64_t bytes, C4Error *outError);
+
+    // For testing: makes the next auto-batch chunk commit fail.
+    void failNextChunkCommit()                          {_failNextChunkCommit = true;}
+
+    // Returns the path of a file in the database directory.
+    std::string filePath(const char *fileName) const {
+        std::string result = path;
+        if (!result.empty() && result.back() != '/' && result.back() != '\\')
+            result += '/';
+        return result + fileName;
+    }
+
+    // Applies `config.tuning` to a connection to the database file.
+    bool applyTuning(C4Database* _cbl_nonnull, C4Error *outError) const;
+
+    // Opens another connection to the database file, for use by a background thread.
+    C4Database* openConnection(C4Error *outError) const;
+
+    // Opens `config.readerCount` read-only connections, for reads and queries.
+    bool openReaders(C4DatabaseConfig2 c4config, C4Error *outError);
+
+    // Picks a reader connection to use for a read, returning its index, or -1 to use `c4db`.
+    // The readers aren't used during a batch, since they can't see its uncommitted changes.
+    // They're handed out round-robin, not checked out: with more reading threads than readers,
+    // two threads can get the same one, and then LiteCore's lock on it makes them take turns.
+    int pickReader() const {
+        if (_readers.empty() || c4db_isInTransaction(c4db))
+            return -1;
+        return int(_nextReader++ % _readers.size());
+    }
+
+    C4Database* reader(int i) const                     {return (i >= 0) ? _readers[i] : c4db;}
+    size_t readerCount() const                          {return _readers.size();}
+
+    // Calls `fn` with a connection on which its reads all see the same commit: a reader with a
+    // read transaction open, or the main connection during a batch. Returns false if a read
+    // transaction couldn't be begun.
+    bool withReadTransaction(std::function<void(C4Database*)> fn, C4Error *outError);
+
+    // Returns a connection with a read transaction open, for a CBLSnapshot.
+    C4Database* beginSnapshot(C4Error *outError);
+
+    // Ends the read transaction begun by `beginSnapshot`, and keeps the connection for reuse.
+    void endSnapshot(C4Database* _cbl_nonnull);
+
+    // Called before closing or deleting the database: stops the background threads, makes the
+    // queries release what they compiled on other connections, and closes all connections
+    // but `c4db`.
+    void closeOtherConnections();
+
+    // Queries register themselves, since they compile copies of themselves on the readers and
+    // snapshot connections, which must be released before those connections close.
+    void registerQuery(CBLQuery* _cbl_nonnull) const;
+    void unregisterQuery(CBLQuery* _cbl_nonnull) const;
+
+    cbl_internal::DocumentCache* documentCache() const  {return _documentCache.get();}
+
+    bool saveDocumentAsync(CBLDocument* _cbl_nonnull,
+                           CBLConcurrencyControl,
+                           CBLSaveCompletionCallback,
+                           void *context,
+                           C4Error *outError);
+    void stopAsyncSaves(bool flush);
+
+    bool startExpirationScheduler(const CBLExpirationSchedulerOptions*, C4Error *outError);
+    void stopExpirationScheduler();
+    void expirationChanged();
+    CBLExpirationStats expirationStats() const;
+
+    bool startAutoCompaction(const CBLAutoCompactionOptions*, C4Error *outError);
+    void stopAutoCompaction();
+    CBLCompactionStats compactionStats() const;
+
 private:
+    static CBLDatabaseConfiguration withoutSecrets(CBLDatabaseConfiguration config) {
+        config.directory = nullptr;
+        config.encryptionKey = {};
+        return config;
+    }
+
+    void startObserving();
     void databaseChanged();
+    void collectChanges(unsigned nChanges, const CBLDatabaseChange changes[],
+                        std::vector<fleece::Retained<CBLListenerToken>> &docListeners);
     void callDBListeners();
     void callDocListeners();
 
     C4DatabaseObserver* _observer {nullptr};
+    std::unique_ptr<cbl_internal::DocumentCache> _documentCache;
+    std::mutex _asyncSaveMutex;
+    std::unique_ptr<cbl_internal::AsyncSaveQueue> _asyncSaveQueue;
+    mutable std::mutex _expirationMutex;
+    std::unique_ptr<cbl_internal::ExpirationScheduler> _expirationScheduler;
+    mutable std::mutex _compactorMutex;
+    std::unique_ptr<cbl_internal::Compactor> _compactor;
+    std::vector<C4Database*> _readers;
+    std::unique_ptr<std::mutex[]> _readerTransactionMutexes;   // One per reader; see withReadTransaction
+    mutable std::mutex _queriesMutex;
+    mutable std::unordered_set<CBLQuery*> _queries;     // Not retained; see registerQuery
+    std::mutex _snapshotMutex;
+    std::vector<C4Database*> _snapshotConnections;      // All connections used by snapshots
+    std::vector<C4Database*> _idleSnapshotConnections;  // The ones not currently in use
+
+    // State of an auto-batch begun by beginAutoBatch
+    struct AutoBatch {
+        uint64_t maxDocs, maxBytes;
+        CBLBatchChunkCallback callback;
+        void* context;
+        uint64_t docs, bytes;               // Changes since the last commit
+        C4Error error;                      // Set if a chunk failed; no transaction is open
+    };
+
+    std::mutex _batchMutex;
+    unsigned _batchDepth {0};
+    std::unique_ptr<AutoBatch> _autoBatch;
+    mutable std::atomic<unsigned> _nextReader {0};
+    std::atomic<bool> _failNextChunkCommit {false};
+    std::mutex _observerMutex;                  // Held while reading changes from _observer
+    std::vector<C4DatabaseChange> _c4changes;   // Buffers for reading changes (_observerMutex)
+    std::vector<CBLDatabaseChange> _changes;
+    std::atomic<unsigned> _maxRawChanges {0};   // Largest `maxChanges` of any raw listener
+    std::mutex _changesMutex;
+    std::vector<std::string> _changedDocIDs;   // Changes not yet sent to listeners
     cbl_internal::Listeners<CBLDatabaseChangeListener> _listeners;
+    cbl_internal::Listeners<CBLDatabaseRawChangeListener> _rawListeners;
     cbl_internal::Listeners<CBLDocumentChangeListener> _docListeners;
+
+    // The document listeners on one docID
+    struct DocListeners {
+        fleece::alloc_slice docID;
+        std::vector<fleece::Retained<CBLListenerToken>> tokens;
+    };
+    // Document listeners indexed by docID; keys point into the values' docIDs.
+    // Guarded by _changesMutex.
+    std::unordered_map<fleece::slice, DocListeners> _docListenerIndex;
     NotificationQueue _notificationQueue;
 };
 
 
+struct CBLSnapshot {
+    fleece::Retained<CBLDatabase> const db;
+    C4Database* const c4db;                 // Connection with a read transaction open
+};
+
+
 namespace cbl_internal {
     static inline C4Database* internal(const CBLDatabase *db)    {return db->c4db;}
+
+    // Frees a query's copies compiled on connections other than the main one. (CBLQuery.cc)
+    void releaseOtherQueries(CBLQuery* _cbl_nonnull);
 }
@@ -21,6 +21,9 @@
 #include "CBLDocument_Internal.hh"
 #include "CBLBlob_Internal.hh"
 #include "Util.hh"
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <mutex>
 
 using namespace std;
@@ -31,10 +34,14 @@ using namespace fleece;
 CBLDocument::CBLDocument(const string &docID,
                          CBLDatabase *db,
                          C4Document *d,          // must be a +1 ref
-                         bool isMutable)
+                         bool isMutable,
+                         C4Database *c4db,       // handle `d` came from; default is db's
+                         bool retainDB)          // false only for a DocumentCache entry
 :_docID(docID)
 ,_db(db)
+,_retainedDB(retainDB ? db : nullptr)
 ,_c4doc(d)
+,_c4db(c4db ? c4db : (db ? internal(db) : nullptr))
 ,_mutable(isMutable)
 {
     if (_c4doc)
@@ -42,6 +49,22 @@ CBLDocument::CBLDocument(const string &docID,
 }
 
 
+// The database's DocumentCache holds entries that don't retain the database, since the database
+// owns the cache. The app gets one of these instead, which does retain the database, and keeps
+// the entry alive. It doesn't claim the C4Document's extraInfo: that still points to the entry,
+// which owns the blobs (see getBlob).
+CBLDocument::CBLDocument(CBLDocument *cacheEntry, CBLDatabase *db)
+:_docID(cacheEntry->_docID)
+,_db(db)
+,_retainedDB(db)
+,_c4doc(c4doc_retain(cacheEntry->_c4doc))
+,_c4db(cacheEntry->_c4db)
+,_properties(cacheEntry->properties())
+,_cacheEntry(cacheEntry)
+,_mutable(false)
+{ }
+
+
 // Construct a new document (not in any database yet)
 CBLDocument::CBLDocument(const char *docID, bool isMutable)
 :CBLDocument(ensureDocID(docID), nullptr, nullptr, isMutable)
@@ -56,15 +79,103 @@ CBLDocument::CBLDocument(CBLDatabase *db, const string &docID, bool isMutable)
 { }
 
 
+// Loads multiple existing documents
+size_t CBLDocument::getAll(CBLDatabase *db _cbl_nonnull,
+                           const char* const docIDs[] _cbl_nonnull,
+                           size_t count,
+                           bool isMutable,
+                           CBLDocument* outDocs[] _cbl_nonnull,
+                           C4Database *snapshot)
+{
+    // Immutable docs can come from, and go into, the database's document cache. But not during a
+    // batch, when the cache doesn't yet know about uncommitted changes, or from a snapshot,
+    // which may be older than the cache:
+    DocumentCache *cache = nullptr;
+    if (!isMutable && !snapshot && !c4db_isInTransaction(internal(db)))
+        cache = db->documentCache();
+    uint64_t generation = cache ? cache->generation() : 0;
+
+    // Immutable docs are read through one of the database's reader connections, if it has any.
+    // (Mutable docs are likely to be saved, which is simpler on the main connection.)
+    C4Database *c4db = snapshot;
+    if (!c4db)
+        c4db = isMutable ? internal(db) : db->reader(db->pickReader());
+
+    auto getDoc = [&](size_t i) {
+        CBLDocument *doc = nullptr;
+        if (cache) {
+            Retained<CBLDocument> cached = cache->get(slice(docIDs[i]), generation);
+            if (cached)
+                doc = retain(new CBLDocument(cached, db));
+        }
+        if (!doc) {
+            C4Document *c4doc = c4doc_getSingleRevision(c4db, slice(docIDs[i]), nullslice,
+                                                         true, nullptr);
+            if (c4doc && cache) {
+                Retained<CBLDocument> entry = new CBLDocument(docIDs[i], db, c4doc, false, c4db,
+                                                              false);
+                cache->put(entry, generation);
+                doc = retain(new CBLDocument(entry, db));
+            } else if (c4doc) {
+                doc = retain(new CBLDocument(docIDs[i], db, c4doc, isMutable, c4db));
+            }
+        }
+        outDocs[i] = doc;
+        return doc != nullptr;
+    };
+
+    if (count == 1)
+        return getDoc(0);
+
+    // Read the docs in docID order, which is the storage order, for better locality:
+    vector<size_t> order(count);
+    for (size_t i = 0; i < count; ++i)
+        order[i] = i;
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return strcmp(docIDs[a], docIDs[b]) < 0;
+    });
+
+    auto getDocs = [&](C4Database *conn) {
+        c4db = conn;
+        size_t found = 0;
+        for (size_t i : order) {
+            if (getDoc(i))
+                ++found;
+        }
+        return found;
+    };
+
+    if (snapshot || isMutable)
+        return getDocs(c4db);
+    // Read them all in one read transaction, so they come from the same commit:
+    size_t found = 0;
+    C4Error error;
+    if (!db->withReadTransaction([&](C4Database *conn) {found = getDocs(conn);}, &error)) {
+        C4LogToAt(kC4DatabaseLog, kC4LogWarning,
+                  "Couldn't begin read transaction for multi-get; reading without one: %d/%d",
+                  error.domain, error.code);
+        found = getDocs(c4db);
+    }
+    return found;
+}
+
+
 // Mutable copy of another CBLDocument
 CBLDocument::CBLDocument(const CBLDocument* otherDoc)
 :CBLDocument(otherDoc->_docID,
              otherDoc->_db,
              c4doc_retain(otherDoc->_c4doc),
-             true)
+             true,
+             otherDoc->_c4db)
 {
-    if (otherDoc->isMutable() && otherDoc->_properties)
-        _properties = otherDoc->_properties.asDict().mutableCopy(kFLDeepCopyImmutables);
+    // The copy is copy-on-write: only the other doc's mutable collections are copied, while
+    // unchanged immutable values are shared. Fleece materializes a mutable copy of a nested
+    // collection only when it's accessed for modification.
+    if (otherDoc->_properties) {
+        auto flags = otherDoc->isMutable() ? kFLDeepCopy : kFLDefaultCopy;
+        _properties = otherDoc->_properties.asDict().mutableCopy(flags);
+        _jsonDoc = otherDoc->_jsonDoc;
+    }
 }
 
 
@@ -104,17 +215,99 @@ RetainedConst<CBLDocument> CBLDocument::save(CBLDatabase* db _cbl_nonnull,
                                              CBLConcurrencyControl concurrency,
                                              C4Error* outError)
 {
-    if (!checkMutable(outError))
+    c4::Transaction t(internal(db));
+    if (!t.begin(outError))
         return nullptr;
-    if (_db && _db != db) {
-        setError(outError, LiteCoreDomain, kC4ErrorInvalidParameter,
-                 "Saving doc to wrong database"_sl);
+
+    c4::ref<C4Document> newDoc = saveInTransaction(db, internal(db),
+                                                   c4db_getSharedFleeceEncoder(internal(db)),
+                                                   deleting, concurrency, outError);
+    if (newDoc && t.commit(outError)
+               && db->documentsSaved(1, newDoc->selectedRev.body.size, outError)) {
+        // Success!
+        return new CBLDocument(_docID, db, c4doc_retain(newDoc), false);
+    } else {
         return nullptr;
     }
+}
 
+
+bool CBLDocument::saveAll(CBLDatabase* db _cbl_nonnull,
+                          CBLDocument* const docs[],
+                          size_t count,
+                          CBLConcurrencyControl concurrency,
+                          C4Error outErrors[],
+                          C4Error* outError)
+{
     c4::Transaction t(internal(db));
     if (!t.begin(outError))
+        return false;
+
+    // Each document's failure is reported individually; it doesn't abort the transaction.
+    FLEncoder encoder = c4db_getSharedFleeceEncoder(internal(db));
+    size_t saved = 0;
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < count; ++i) {
+        C4Error error = {};
+        c4::ref<C4Document> newDoc = docs[i]->saveInTransaction(db, internal(db), encoder, false,
+                                                                concurrency, &error);
+        if (newDoc) {
+            ++saved;
+            bytes += newDoc->selectedRev.body.size;
+        }
+        if (outErrors)
+            outErrors[i] = newDoc ? C4Error{} : error;
+    }
+    return t.commit(outError) && db->documentsSaved(saved, bytes, outError);
+}
+
+
+bool CBLDocument::saveGroup(CBLDatabase* db _cbl_nonnull,
+                            C4Database* c4db _cbl_nonnull,
+                            SaveRequest requests[],
+                            size_t count,
+                            C4Error* outError)
+{
+    vector<c4::ref<C4Document>> newDocs(count);
+    {
+        c4::Transaction t(c4db);
+        if (!t.begin(outError))
+            return false;
+        FLEncoder encoder = c4db_getSharedFleeceEncoder(c4db);
+        for (size_t i = 0; i < count; ++i) {
+            SaveRequest &rq = requests[i];
+            newDocs[i] = rq.doc->saveInTransaction(db, c4db, encoder, false, rq.concurrency,
+                                                   &rq.error);
+        }
+        if (!t.commit(outError))
+            return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (newDocs[i])
+            requests[i].savedDoc = new CBLDocument(requests[i].doc->_docID, db,
+                                                   c4doc_retain(newDocs[i]), false, c4db);
+    }
+    return true;
+}
+
+
+// Saves the document; the caller must already have begun a transaction on `c4db`, which is
+// normally the database's own C4Database but may be another handle on the same file.
+// Returns the new revision as a +1 ref, or null on failure.
+C4Document* CBLDocument::saveInTransaction(CBLDatabase* db _cbl_nonnull,
+                                           C4Database* c4db _cbl_nonnull,
+                                           FLEncoder encoder _cbl_nonnull,
+                                           bool deleting,
+                                           CBLConcurrencyControl concurrency,
+                                           C4Error* outError)
+{
+    if (!checkMutable(outError))
+        return nullptr;
+    if (_db && _db != db) {
+        setError(outError, LiteCoreDomain, kC4ErrorInvalidParameter,
+                 "Saving doc to wrong database"_sl);
         return nullptr;
+    }
 
     // Save new blobs:
     if (!saveBlobs(db, outError))
@@ -123,7 +316,7 @@ RetainedConst<CBLDocument> CBLDocument::save(CBLDatabase* db _cbl_nonnull,
     // Encode properties:
     alloc_slice body;
     if (!deleting) {
-        Encoder enc(c4db_getSharedFleeceEncoder(internal(db)));
+        Encoder enc(encoder);
         enc.writeValue(properties());
         body = enc.finish();
         enc.detach();
@@ -134,6 +327,23 @@ RetainedConst<CBLDocument> CBLDocument::save(CBLDatabase* db _cbl_nonnull,
     c4::ref<C4Document> newDoc = nullptr;
     C4Error c4err;
 
+    if (savingDoc && _c4db != c4db) {
+        // My C4Document can only be updated in a transaction on the handle it came from, so
+        // read the current revision through `c4db`, and check that it's the one I started from:
+        savingDoc = c4doc_getSingleRevision(c4db, slice(_docID), nullslice, true, &c4err);
+        if (!savingDoc && !(c4err == C4Error{LiteCoreDomain, kC4ErrorNotFound})) {
+            if (outError)
+                *outError = c4err;
+            return nullptr;
+        }
+        if (concurrency == kCBLConcurrencyControlFailOnConflict
+                && (!savingDoc || slice(savingDoc->selectedRev.revID)
+                                        != slice(_c4doc->selectedRev.revID))) {
+            setError(outError, LiteCoreDomain, kC4ErrorConflict, "Document has been changed"_sl);
+            return nullptr;
+        }
+    }
+
     bool retrying = false;
     do {
         C4RevisionFlags flags = (deleting ? kRevDeleted : 0);
@@ -145,7 +355,7 @@ RetainedConst<CBLDocument> CBLDocument::save(CBLDatabase* db _cbl_nonnull,
             rq.docID = slice(_docID);
             rq.revFlags = flags;
             rq.save = true;
-            newDoc = c4doc_put(internal(db), &rq, nullptr, &c4err);
+            newDoc = c4doc_put(c4db, &rq, nullptr, &c4err);
         }
 
         if (!newDoc && c4err == C4Error{LiteCoreDomain, kC4ErrorConflict}
@@ -153,22 +363,18 @@ RetainedConst<CBLDocument> CBLDocument::save(CBLDatabase* db _cbl_nonnull,
             // Conflict; in last-write-wins mode, load current revision and retry:
             if (retrying)
                 break;  // (but only once)
-            savingDoc = c4doc_getSingleRevision(internal(db), slice(_docID), nullslice, true,
-                                                &c4err);
+            savingDoc = c4doc_getSingleRevision(c4db, slice(_docID), nullslice, true, &c4err);
             if (savingDoc || c4err == C4Error{LiteCoreDomain, kC4ErrorNotFound})
                 retrying = true;
         }
     } while (retrying);
 
-    if (newDoc && t.commit(&c4err)) {
-        // Success!
-        return new CBLDocument(_docID, db, c4doc_retain(newDoc), false);
-    } else {
-        // Failure:
+    if (!newDoc) {
         if (outError)
             *outError = c4err;
         return nullptr;
     }
+    return c4doc_retain(newDoc);
 }
 
 
@@ -193,7 +399,59 @@ bool CBLDocument::deleteDoc(CBLDatabase* db _cbl_nonnull,
                                                         false, outError);
     if (c4doc)
         c4doc = c4doc_update(c4doc, nullslice, kRevDeleted, outError);
-    return c4doc && t.commit(outError);
+    return c4doc && t.commit(outError) && db->documentsSaved(1, 0, outError);
+}
+
+
+int64_t CBLDocument::removeAll(CBLDatabase* db _cbl_nonnull,
+                               const char* const docIDs[] _cbl_nonnull,
+                               size_t count,
+                               size_t chunkSize,
+                               bool purge,
+                               CBLBatchProgressCallback progress,
+                               void *context,
+                               C4Error* outError)
+{
+    static constexpr size_t kDefaultChunkSize = 1000;
+    if (chunkSize == 0)
+        chunkSize = kDefaultChunkSize;
+
+    C4Database *c4db = internal(db);
+    size_t removed = 0;
+    for (size_t start = 0; start < count; start += chunkSize) {
+        size_t removedBefore = removed;
+        size_t end = min(start + chunkSize, count);
+        c4::Transaction t(c4db);
+        if (!t.begin(outError))
+            return -1;
+        for (size_t i = start; i < end; ++i) {
+            C4Error error;
+            bool ok;
+            if (purge) {
+                ok = c4db_purgeDoc(c4db, slice(docIDs[i]), &error);
+            } else {
+                c4::ref<C4Document> c4doc = c4doc_getSingleRevision(c4db, slice(docIDs[i]),
+                                                                    nullslice, false, &error);
+                if (c4doc && (c4doc->flags & kDocDeleted))
+                    continue;
+                if (c4doc)
+                    c4doc = c4doc_update(c4doc, nullslice, kRevDeleted, &error);
+                ok = (c4doc != nullptr);
+            }
+            if (ok) {
+                ++removed;
+            } else if (!(error == C4Error{LiteCoreDomain, kC4ErrorNotFound})) {
+                if (outError)
+                    *outError = error;
+                return -1;
+            }
+        }
+        if (!t.commit(outError) || !db->documentsSaved(removed - removedBefore, 0, outError))
+            return -1;
+        if (progress && !progress(context, end, removed))
+            break;
+    }
+    return int64_t(removed);
 }
 
 
@@ -222,13 +480,24 @@ Dict CBLDocument::properties() const {
 }
 
 
-char* CBLDocument::propertiesAsJSON() const {
-    alloc_slice json;
+void CBLDocument::setProperties(MutableDict d) {
+    if (!checkMutable(nullptr))
+        return;
+    // (_jsonDoc is kept, since `d` may contain values taken from the JSON properties.)
+    _properties = d;
+}
+
+
+alloc_slice CBLDocument::propertiesJSON() const {
     if (!_mutable && _c4doc)
-        json = c4doc_bodyAsJSON(_c4doc, false, nullptr);        // fast path
+        return alloc_slice(c4doc_bodyAsJSON(_c4doc, false, nullptr));     // fast path
     else
-        json = allocCString(properties().toJSON());
-    return allocCString(json);
+        return properties().toJSON();
+}
+
+
+char* CBLDocument::propertiesAsJSON() const {
+    return allocCString(propertiesJSON());
 }
 
 
@@ -240,12 +509,21 @@ bool CBLDocument::setPropertiesAsJSON(const char *json, C4Error* outError) {
         setError(outError, FleeceDomain, kFLJSONError, "Invalid JSON"_sl);
         return false;
     }
+    return setPropertiesFromDoc(doc, outError);
+}
+
+
+bool CBLDocument::setPropertiesFromDoc(Doc doc, C4Error* outError) {
+    if (!checkMutable(outError))
+        return false;
     Dict root = doc.root().asDict();
     if (!root) {
         setError(outError, FleeceDomain, kFLJSONError, "properties must be a JSON dictionary"_sl);
         return false;
     }
-    _properties = root.mutableCopy(kFLDeepCopyImmutables);
+    // Keep the Doc, so the mutable properties can point into it instead of copying it:
+    _properties = root.mutableCopy();
+    _jsonDoc = doc;
     return true;
 }
 
@@ -253,11 +531,73 @@ bool CBLDocument::setPropertiesAsJSON(const char *json, C4Error* outError) {
 #pragma mark - BLOBS:
 
 
-CBLDocument::UnretainedValueToBlobMap* CBLDocument::sNewBlobs = nullptr;
-mutex sNewBlobsMutex;
+namespace {
+
+    // Registry of CBLNewBlobs that haven't been saved yet, keyed by their properties Dict.
+    // It's split into shards with their own mutexes, so that threads creating and saving blobs
+    // at the same time rarely contend for a lock.
+    class NewBlobRegistry {
+    public:
+        void insert(FLDict key, CBLNewBlob *blob) {
+            Shard &s = shard(key);
+            lock_guard<mutex> lock(s.blobsMutex);
+            if (s.blobs.insert({key, blob}).second)
+                s.count.fetch_add(1, memory_order_release);
+        }
+
+        void erase(FLDict key) {
+            Shard &s = shard(key);
+            lock_guard<mutex> lock(s.blobsMutex);
+            if (s.blobs.erase(key) > 0)
+                s.count.fetch_sub(1, memory_order_release);
+        }
+
+        CBLNewBlob* find(FLDict key) {
+            Shard &s = shard(key);
+            lock_guard<mutex> lock(s.blobsMutex);
+            auto i = s.blobs.find(key);
+            return (i != s.blobs.end()) ? i->second : nullptr;
+        }
+
+        // True if there are no unsaved blobs at all. Doesn't lock.
+        bool empty() const {
+            for (auto &s : _shards) {
+                if (s.count.load(memory_order_acquire) > 0)
+                    return false;
+            }
+            return true;
+        }
+
+    private:
+        static constexpr size_t kNumShards = 32;
+
+        struct Shard {
+            mutex                                   blobsMutex;
+            unordered_map<FLDict, CBLNewBlob*>      blobs;
+            atomic<size_t>                          count {0};      // == blobs.size()
+        };
+
+        Shard& shard(FLDict key) {
+            // (Ignore the low bits of the address, which are zero due to heap alignment.)
+            return _shards[(uintptr_t(key) >> 4) % kNumShards];
+        }
+
+        Shard _shards[kNumShards];
+    };
+
+    NewBlobRegistry& newBlobs() {
+        static NewBlobRegistry sNewBlobs;
+        return sNewBlobs;
+    }
+
+}
 
 
 CBLBlob* CBLDocument::getBlob(FLDict dict) {
+    if (_cacheEntry)
+        return _cacheEntry->getBlob(dict);
+    // (An immutable doc may be shared by multiple threads via the database's document cache.)
+    lock_guard<mutex> lock(_blobsMutex);
     // Is it already registered by a previous call to getBlob?
     auto i = _blobs.find(dict);
     if (i != _blobs.end())
@@ -278,26 +618,17 @@ CBLBlob* CBLDocument::getBlob(FLDict dict) {
 
 
 void CBLDocument::registerNewBlob(CBLNewBlob* blob) {
-    lock_guard<mutex> lock(sNewBlobsMutex);
-    if (!sNewBlobs)
-        sNewBlobs = new UnretainedValueToBlobMap;
-    sNewBlobs->insert({blob->properties(), blob});
+    newBlobs().insert(blob->properties(), blob);
 }
 
 
 void CBLDocument::unregisterNewBlob(CBLNewBlob* blob) {
-    lock_guard<mutex> lock(sNewBlobsMutex);
-    if (sNewBlobs)
-        sNewBlobs->erase(blob->properties());
+    newBlobs().erase(blob->properties());
 }
 
 
 CBLNewBlob* CBLDocument::findNewBlob(FLDict dict) {
-    lock_guard<mutex> lock(sNewBlobsMutex);
-    auto i = sNewBlobs->find(dict);
-    if (i == sNewBlobs->end())
-        return nullptr;
-    return i->second;
+    return newBlobs().find(dict);
 }
 
 
@@ -306,6 +637,10 @@ bool CBLDocument::saveBlobs(CBLDatabase *db, C4Error *outError) {
     // We can skip any immutable collections (they can't contain new blobs.)
     if (!isMutable())
         return true;
+    // If no unsaved blobs exist, the walk can't find anything, so skip it. (This is the common
+    // case, since a blob is only unsaved between its creation and the save of its document.)
+    if (newBlobs().empty())
+        return true;
     for (DeepIterator i(properties()); i; ++i) {
         Dict dict = i.value().asDict();
         if (dict) {
@@ -331,23 +666,53 @@ bool CBLDocument::saveBlobs(CBLDatabase *db, C4Error *outError) {
 
 
 static CBLDocument* getDocument(CBLDatabase* db, const char* docID, bool isMutable) CBLAPI {
-    auto doc = retained(new CBLDocument(db, docID, isMutable));
-    return doc->exists() ? retain(doc.get()) : nullptr;
+    CBLDocument *doc;
+    CBLDocument::getAll(db, &docID, 1, isMutable, &doc);
+    return doc;
 }
 
 const CBLDocument* CBLDatabase_GetDocument(const CBLDatabase* db, const char* docID) CBLAPI {
     return getDocument((CBLDatabase*)db, docID, false);
 }
 
+size_t CBLDatabase_GetDocuments(const CBLDatabase* db,
+                                const char* const docIDs[],
+                                size_t count,
+                                const CBLDocument* outDocs[]) CBLAPI
+{
+    return CBLDocument::getAll((CBLDatabase*)db, docIDs, count, false, (CBLDocument**)outDocs);
+}
+
 CBLDocument* CBLDatabase_GetMutableDocument(CBLDatabase* db, const char* docID) CBLAPI {
     return getDocument(db, docID, true);
 }
 
+const CBLDocument* CBLSnapshot_GetDocument(const CBLSnapshot* snapshot, const char* docID) CBLAPI {
+    CBLDocument *doc;
+    CBLDocument::getAll(snapshot->db, &docID, 1, false, &doc, snapshot->c4db);
+    return doc;
+}
+
+size_t CBLSnapshot_GetDocuments(const CBLSnapshot* snapshot,
+                                const char* const docIDs[],
+                                size_t count,
+                                const CBLDocument* outDocs[]) CBLAPI
+{
+    return CBLDocument::getAll(snapshot->db, docIDs, count, false, (CBLDocument**)outDocs,
+                               snapshot->c4db);
+}
+
 CBLDocument* CBLDocument_New(const char *docID) CBLAPI {
     return retain(new CBLDocument(docID, true));
 }
 
 CBLDocument* CBLDocument_MutableCopy(const CBLDocument* doc) CBLAPI {
+    if (!doc->hasBody()) {
+        // Its empty properties would overwrite the real ones if the copy were saved:
+        C4LogToAt(kC4DatabaseLog, kC4LogWarning,
+                  "Can't make a mutable copy of doc '%s', whose body wasn't read", doc->docID());
+        return nullptr;
+    }
     return retain(new CBLDocument(doc));
 }
 
@@ -359,6 +724,18 @@ FLDoc CBLDocument_CreateFleeceDoc(const CBLDocument* doc) CBLAPI       {return d
 
 char* CBLDocument_PropertiesAsJSON(const CBLDocument* doc) CBLAPI      {return doc->propertiesAsJSON();}
 
+FLSliceResult CBLDocument_PropertiesToJSON(const CBLDocument* doc) CBLAPI {
+    return FLSliceResult(doc->propertiesJSON());
+}
+
+bool CBLDocument_WritePropertiesJSON(const CBLDocument* doc,
+                                     CBLJSONWriter writer,
+                                     void *context) CBLAPI
+{
+    alloc_slice json = doc->propertiesJSON();
+    return writer(context, json.buf, json.size);
+}
+
 void CBLDocument_SetProperties(CBLDocument* doc, FLMutableDict properties _cbl_nonnull) CBLAPI {
     doc->setProperties(properties);
 }
@@ -375,6 +752,32 @@ const CBLDocument* CBLDatabase_SaveDocument(CBLDatabase* db,
     return retain(doc->save(db, false, concurrency, internal(outError)).get());
 }
 
+bool CBLDatabase_SaveDocuments(CBLDatabase* db,
+                               CBLDocument* const docs[],
+                               size_t count,
+                               CBLConcurrencyControl concurrency,
+                               CBLError outErrors[],
+                               CBLError* outError) CBLAPI
+{
+    return CBLDocument::saveAll(db, docs, count, concurrency,
+                                (C4Error*)outErrors, internal(outError));
+}
+
+bool CBLDatabase_SaveDocumentAsync(CBLDatabase* db,
+                                   CBLDocument* doc,
+                                   CBLConcurrencyControl concurrency,
+                                   CBLSaveCompletionCallback callback,
+                                   void *context,
+                                   CBLError* outError) CBLAPI
+{
+    if (!doc->isMutable()) {
+        setError(internal(outError), LiteCoreDomain, kC4ErrorNotWriteable,
+                 "Document object is immutable"_sl);
+        return false;
+    }
+    return db->saveDocumentAsync(doc, concurrency, callback, context, internal(outError));
+}
+
 bool CBLDocument_Delete(const CBLDocument* doc _cbl_nonnull,
                     CBLConcurrencyControl concurrency,
                     CBLError* outError) CBLAPI
@@ -402,6 +805,80 @@ bool CBLDatabase_PurgeDocumentByID(CBLDatabase* db _cbl_nonnull,
     return c4db_purgeDoc(internal(db), slice(docID), internal(outError));
 }
 
+int64_t CBLDatabase_DeleteDocumentsByID(CBLDatabase* db _cbl_nonnull,
+                                        const char* const docIDs[] _cbl_nonnull,
+                                        size_t count,
+                                        size_t chunkSize,
+                                        CBLBatchProgressCallback progress,
+                                        void *context,
+                                        CBLError* outError) CBLAPI
+{
+    return CBLDocument::removeAll(db, docIDs, count, chunkSize, false, progress, context,
+                                  internal(outError));
+}
+
+int64_t CBLDatabase_PurgeDocumentsByID(CBLDatabase* db _cbl_nonnull,
+                                       const char* const docIDs[] _cbl_nonnull,
+                                       size_t count,
+                                       size_t chunkSize,
+                                       CBLBatchProgressCallback progress,
+                                       void *context,
+                                       CBLError* outError) CBLAPI
+{
+    return CBLDocument::removeAll(db, docIDs, count, chunkSize, true, progress, context,
+                                  internal(outError));
+}
+
+bool CBLDatabase_GetDocumentInfo(const CBLDatabase* db _cbl_nonnull,
+                                 const char *docID _cbl_nonnull,
+                                 CBLDocumentInfoFields fields,
+                                 CBLDocumentInfo *outInfo _cbl_nonnull,
+                                 CBLError* outError) CBLAPI
+{
+    bool found = false;
+    C4Error c4err = {};
+    auto getInfo = [&](C4Database *c4db) {
+        // Load only the metadata; the body is never read:
+        c4::ref<C4Document> c4doc = c4doc_getSingleRevision(c4db, slice(docID), nullslice,
+                                                            false, &c4err);
+        if (!c4doc) {
+            if (c4err == C4Error{LiteCoreDomain, kC4ErrorNotFound})
+                c4err = {};
+            return;
+        }
+        found = true;
+        *outInfo = {};
+        outInfo->docID = slice(docID);
+        outInfo->sequence = c4doc->sequence;
+        outInfo->flags = c4doc->flags;
+        if (fields & kCBLDocumentInfoExpiration)
+            outInfo->expiration = c4doc_getExpiration(c4db, slice(docID), nullptr);
+        if (fields & kCBLDocumentInfoBodySize) {
+            // The body size comes from the sequence index, which starts right at the doc's
+            // sequence:
+            C4EnumeratorOptions c4opts = kC4DefaultEnumeratorOptions;
+            c4opts.flags &= ~kC4IncludeBodies;
+            c4opts.flags |= kC4IncludeDeleted;
+            c4::ref<C4DocEnumerator> e = c4db_enumerateChanges(c4db, c4doc->sequence - 1,
+                                                               &c4opts, nullptr);
+            C4DocumentInfo c4info;
+            if (e && c4enum_next(e, nullptr) && c4enum_getDocumentInfo(e, &c4info)
+                  && c4info.sequence == c4doc->sequence)
+                outInfo->bodySize = c4info.bodySize;
+        }
+    };
+
+    if (fields == 0) {
+        // A single lookup doesn't need a transaction:
+        getInfo(db->reader(db->pickReader()));
+    } else if (!((CBLDatabase*)db)->withReadTransaction(getInfo, &c4err)) {
+        found = false;
+    }
+    if (!found && outError)
+        *internal(outError) = c4err;
+    return found;
+}
+
 time_t CBLDatabase_GetDocumentExpiration(CBLDatabase* db _cbl_nonnull,
                                          const char *docID _cbl_nonnull,
                                          CBLError* error) CBLAPI
@@ -414,5 +891,251 @@ bool CBLDatabase_SetDocumentExpiration(CBLDatabase* db _cbl_nonnull,
                                        time_t expiration,
                                        CBLError* error) CBLAPI
 {
-    return c4doc_setExpiration(internal(db), slice(docID), expiration, internal(error));
+    if (!c4doc_setExpiration(internal(db), slice(docID), expiration, internal(error)))
+        return false;
+    if (expiration > 0)
+        db->expirationChanged();
+    return true;
+}
+
+
+#pragma mark - ENUMERATION:
+
+
+CBLDocument* CBLDocument::fromEnumerator(CBLDatabase* db, C4Database* c4db, C4DocEnumerator* e,
+                                         bool withBody, C4Error* outError)
+{
+    c4::ref<C4Document> c4doc = c4enum_getDocument(e, outError);
+    if (!c4doc)
+        return nullptr;
+    // (A tombstone may have no body to load; its properties are just empty.)
+    if (withBody && !c4doc->selectedRev.body.buf && !(c4doc->flags & kDocDeleted)
+            && !c4doc_loadRevisionBody(c4doc, outError))
+        return nullptr;
+    string docID(slice(c4doc->docID));
+    auto doc = new CBLDocument(docID, db, c4doc_retain(c4doc), false, c4db);
+    doc->_metadataOnly = !withBody;
+    return retain(doc);
+}
+
+
+struct CBLDocumentEnumerator {
+    CBLDocumentEnumerator(CBLDatabase *db, C4Database *snapshot, const CBLEnumeratorOptions &opts)
+    :_db(db)
+    ,_snapshot(snapshot)
+    ,_start(opts.startDocID ? opts.startDocID : "")
+    ,_end(opts.endDocID ? opts.endDocID : "")
+    ,_hasStart(opts.startDocID != nullptr)
+    ,_hasEnd(opts.endDocID != nullptr)
+    ,_descending(opts.descending)
+    ,_includeDeleted(opts.includeDeleted)
+    ,_bySequence(opts.sinceSequence > 0)
+    ,_withBodies(!opts.metadataOnly)
+    { }
+
+    ~CBLDocumentEnumerator() {
+        _c4enum = nullptr;
+        if (_snapshot)
+            _db->endSnapshot(_snapshot);
+    }
+
+    bool start(uint64_t since, C4Error *outError) {
+        C4EnumeratorOptions c4opts = kC4DefaultEnumeratorOptions;
+        if (_descending)
+            c4opts.flags |= kC4Descending;
+        if (_includeDeleted)
+            c4opts.flags |= kC4IncludeDeleted;
+        if (!_withBodies)
+            c4opts.flags &= ~kC4IncludeBodies;
+        C4Database *c4db = connection();
+        if (_bySequence)
+            _c4enum = c4db_enumerateChanges(c4db, since, &c4opts, outError);
+        else
+            _c4enum = c4db_enumerateAllDocs(c4db, &c4opts, outError);
+        return _c4enum != nullptr;
+    }
+
+    size_t next(CBLDocument* outDocs[], size_t maxDocs, C4Error *outError) {
+        *outError = {};
+        size_t n = 0;
+        while (n < maxDocs && !_done) {
+            if (!c4enum_next(_c4enum, outError)) {
+                _done = true;
+                break;
+            }
+            C4DocumentInfo info;
+            c4enum_getDocumentInfo(_c4enum, &info);
+            int range = inRange(info.docID);
+            if (range > 0 && !_bySequence) {
+                _done = true;           // Past the end docID
+                break;
+            } else if (range != 0) {
+                continue;
+            }
+            CBLDocument *doc = CBLDocument::fromEnumerator(_db, connection(), _c4enum,
+                                                           _withBodies, outError);
+            if (!doc)
+                break;
+            outDocs[n++] = doc;
+        }
+        if (outError->code) {
+            for (size_t i = 0; i < n; ++i)
+                release(outDocs[i]);
+            return 0;
+        }
+        return n;
+    }
+
+private:
+    C4Database* connection() const         {return _snapshot ? _snapshot : internal(_db);}
+
+    // Returns -1 if the docID comes before the range (in enumeration order), 1 if after it,
+    // else 0.
+    int inRange(slice docID) const {
+        int sign = _descending ? -1 : 1;
+        if (_hasStart && sign * docID.compare(slice(_start)) < 0)
+            return -1;
+        if (_hasEnd && sign * docID.compare(slice(_end)) > 0)
+            return 1;
+        return 0;
+    }
+
+    Retained<CBLDatabase> const _db;
+    C4Database* const _snapshot;                // Connection with a read transaction, or null
+    c4::ref<C4DocEnumerator> _c4enum;
+    string const _start, _end;
+    bool const _hasStart, _hasEnd, _descending, _includeDeleted, _bySequence, _withBodies;
+    bool _done {false};
+};
+
+
+CBLDocumentEnumerator* CBLDatabase_EnumerateDocuments(const CBLDatabase* constdb,
+                                                      const CBLEnumeratorOptions *inOptions,
+                                                      CBLError* outError) CBLAPI
+{
+    auto db = const_cast<CBLDatabase*>(constdb);
+    CBLEnumeratorOptions options = inOptions ? *inOptions : CBLEnumeratorOptions{};
+    // Use a snapshot, so the enumerator's long-lived read transaction doesn't affect other reads
+    // on a shared connection. But during a batch, enumerate the main connection so the batch's
+    // changes are visible.
+    C4Database *snapshot = nullptr;
+    if (!c4db_isInTransaction(internal(db))) {
+        snapshot = db->beginSnapshot(internal(outError));
+        if (!snapshot)
+            return nullptr;
+    }
+    auto e = new CBLDocumentEnumerator(db, snapshot, options);
+    if (!e->start(options.sinceSequence, internal(outError))) {
+        delete e;
+        return nullptr;
+    }
+    return e;
+}
+
+size_t CBLDocumentEnumerator_Next(CBLDocumentEnumerator* e,
+                                  const CBLDocument* outDocs[],
+                                  size_t maxDocs,
+                                  CBLError* outError) CBLAPI
+{
+    C4Error error;
+    size_t n = e->next((CBLDocument**)outDocs, maxDocs, &error);
+    if (outError)
+        *internal(outError) = error;
+    return n;
+}
+
+void CBLDocumentEnumerator_Free(CBLDocumentEnumerator* e) CBLAPI {
+    delete e;
+}
+
+
+#pragma mark - CHANGES FEED:
+
+
+// The raw (non-document) KeyStore that holds changes-feed cursors
+static constexpr slice kCursorStore = "cbl_cursors"_sl;
+
+
+namespace {
+    // The actual object behind a CBLChanges; owns the docIDs the items point to.
+    struct ChangesBatch : public CBLChanges {
+        vector<CBLDocumentInfo> items;
+        vector<alloc_slice> docIDs;
+    };
+}
+
+
+CBLChanges* CBLDatabase_GetChangesSince(const CBLDatabase* db _cbl_nonnull,
+                                        uint64_t since,
+                                        size_t limit,
+                                        CBLError* outError) CBLAPI
+{
+    C4EnumeratorOptions c4opts = kC4DefaultEnumeratorOptions;
+    c4opts.flags |= kC4IncludeDeleted;
+    c4opts.flags &= ~kC4IncludeBodies;
+    c4::ref<C4DocEnumerator> e = c4db_enumerateChanges(internal(db), since, &c4opts,
+                                                        internal(outError));
+    if (!e)
+        return nullptr;
+
+    unique_ptr<ChangesBatch> batch(new ChangesBatch);
+    batch->lastSequence = since;
+    C4Error error = {};
+    while ((limit == 0 || batch->items.size() < limit) && c4enum_next(e, &error)) {
+        C4DocumentInfo info;
+        c4enum_getDocumentInfo(e, &info);
+        batch->docIDs.emplace_back(info.docID);
+        CBLDocumentInfo item = {};
+        item.docID = batch->docIDs.back();
+        item.sequence = info.sequence;
+        item.flags = info.flags;
+        item.bodySize = info.bodySize;
+        batch->items.push_back(item);
+        batch->lastSequence = info.sequence;
+    }
+    if (error.code) {
+        if (outError)
+            *internal(outError) = error;
+        return nullptr;
+    }
+    batch->changes = batch->items.data();
+    batch->count = batch->items.size();
+    return batch.release();
+}
+
+void CBLChanges_Free(CBLChanges* changes) CBLAPI {
+    delete static_cast<ChangesBatch*>(changes);
+}
+
+bool CBLDatabase_SetChangesCursor(CBLDatabase* db _cbl_nonnull,
+                                  const char *name _cbl_nonnull,
+                                  uint64_t sequence,
+                                  CBLError* outError) CBLAPI
+{
+    string value = to_string(sequence);
+    c4::Transaction t(internal(db));
+    return t.begin(internal(outError))
+        && c4raw_put(internal(db), kCursorStore, slice(name), nullslice, slice(value),
+                     internal(outError))
+        && t.commit(internal(outError));
+}
+
+uint64_t CBLDatabase_GetChangesCursor(const CBLDatabase* db _cbl_nonnull,
+                                      const char *name _cbl_nonnull,
+                                      CBLError* outError) CBLAPI
+{
+    C4Error error;
+    C4RawDocument *raw = c4raw_get(internal(db), kCursorStore, slice(name), &error);
+    if (!raw) {
+        if (error == C4Error{LiteCoreDomain, kC4ErrorNotFound})
+            error = {};
+        if (outError)
+            *internal(outError) = error;
+        return 0;
+    }
+    uint64_t sequence = strtoull(string(slice(raw->body)).c_str(), nullptr, 10);
+    c4raw_free(raw);
+    if (outError)
+        outError->code = 0;
+    return sequence;
 }
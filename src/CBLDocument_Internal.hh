@@ -24,6 +24,7 @@
 #include "c4Document+Fleece.h"
 #include "fleece/Fleece.hh"
 #include "fleece/Mutable.hh"
+#include <mutex>
 #include <unordered_map>
 
 using namespace std;
@@ -41,6 +42,16 @@ public:
     // Construct on an existing document
     CBLDocument(CBLDatabase *db, const string &docID, bool isMutable);
 
+    // Loads multiple existing documents; missing ones are stored as nullptr. Returns # found.
+    // Immutable documents are looked up in, and added to, the database's document cache.
+    // If `snapshot` is given, the documents are read from that connection, bypassing the cache.
+    static size_t getAll(CBLDatabase *db _cbl_nonnull,
+                         const char* const docIDs[] _cbl_nonnull,
+                         size_t count,
+                         bool isMutable,
+                         CBLDocument* outDocs[] _cbl_nonnull,
+                         C4Database *snapshot = nullptr);
+
     // Mutable copy of another CBLDocument
     CBLDocument(const CBLDocument* otherDoc);
 
@@ -59,21 +70,48 @@ public:
     const char* docID() const                   {return _docID.c_str();}
     bool exists() const                         {return _c4doc != nullptr;}
     uint64_t sequence() const                   {return _c4doc ? _c4doc->sequence : 0;}
+    size_t bodySize() const                     {return _c4doc ? _c4doc->selectedRev.body.size : 0;}
     bool isMutable() const                      {return _mutable;}
+    bool hasBody() const                        {return !_metadataOnly;}
 
     FLDoc createFleeceDoc() const               {return c4doc_createFleeceDoc(_c4doc);}
     Dict properties() const;
     MutableDict mutableProperties()             {return properties().asMutable();}
-    void setProperties(MutableDict d)           {if (checkMutable(nullptr)) _properties = d;}
+    void setProperties(MutableDict d);
 
+    alloc_slice propertiesJSON() const;
     char* propertiesAsJSON() const;
     bool setPropertiesAsJSON(const char *json, C4Error* outError);
+    bool setPropertiesFromDoc(Doc doc, C4Error* outError);
 
     RetainedConst<CBLDocument> save(CBLDatabase* db _cbl_nonnull,
                                     bool deleting,
                                     CBLConcurrencyControl concurrency,
                                     C4Error* outError);
 
+    static bool saveAll(CBLDatabase* db _cbl_nonnull,
+                        CBLDocument* const docs[],
+                        size_t count,
+                        CBLConcurrencyControl concurrency,
+                        C4Error outErrors[],
+                        C4Error* outError);
+
+    // A document to be saved by saveGroup, and the result of saving it.
+    struct SaveRequest {
+        Retained<CBLDocument>       doc;
+        CBLConcurrencyControl       concurrency;
+        RetainedConst<CBLDocument>  savedDoc;       // New revision, if successful
+        C4Error                     error;          // Error, if not
+    };
+
+    // Saves documents in one transaction on `c4db`, which may be a different C4Database handle
+    // (on the same file) than the database's own. Returns false if the commit failed.
+    static bool saveGroup(CBLDatabase* db _cbl_nonnull,
+                          C4Database* c4db _cbl_nonnull,
+                          SaveRequest requests[],
+                          size_t count,
+                          C4Error* outError);
+
     bool deleteDoc(CBLConcurrencyControl concurrency,
                    C4Error* outError);
 
@@ -81,13 +119,35 @@ public:
                           const char* docID _cbl_nonnull,
                           C4Error* outError);
 
+    // Deletes or purges docs by ID, committing a transaction every `chunkSize` docs.
+    // Returns the number of docs removed, or -1 on error.
+    static int64_t removeAll(CBLDatabase* db _cbl_nonnull,
+                             const char* const docIDs[] _cbl_nonnull,
+                             size_t count,
+                             size_t chunkSize,
+                             bool purge,
+                             CBLBatchProgressCallback progress,
+                             void *context,
+                             C4Error* outError);
+
+    // Returns the document at the current position of a C4DocEnumerator on `c4db`.
+    static CBLDocument* fromEnumerator(CBLDatabase* db _cbl_nonnull,
+                                       C4Database* c4db _cbl_nonnull,
+                                       C4DocEnumerator* e _cbl_nonnull,
+                                       bool withBody,
+                                       C4Error* outError);
+
     CBLBlob* getBlob(FLDict _cbl_nonnull);
 
     static void registerNewBlob(CBLNewBlob* _cbl_nonnull);
     static void unregisterNewBlob(CBLNewBlob* _cbl_nonnull);
 
 private:
-    CBLDocument(const string &docID, CBLDatabase *db, C4Document *d, bool isMutable);
+    CBLDocument(const string &docID, CBLDatabase *db, C4Document *d, bool isMutable,
+                C4Database *c4db =nullptr, bool retainDB =true);
+
+    // Immutable document sharing the contents of a DocumentCache entry
+    CBLDocument(CBLDocument *cacheEntry _cbl_nonnull, CBLDatabase *db _cbl_nonnull);
     virtual ~CBLDocument();
 
     void initProperties();
@@ -95,18 +155,28 @@ private:
 
     static string ensureDocID(const char *docID);
 
+    C4Document* saveInTransaction(CBLDatabase* db _cbl_nonnull,
+                                  C4Database* c4db _cbl_nonnull,
+                                  FLEncoder encoder _cbl_nonnull,
+                                  bool deleting,
+                                  CBLConcurrencyControl concurrency,
+                                  C4Error* outError);
+
     static CBLNewBlob* findNewBlob(FLDict dict _cbl_nonnull);
     bool saveBlobs(CBLDatabase *db, C4Error *outError);
 
     using ValueToBlobMap = std::unordered_map<FLDict, Retained<CBLBlob>>;
-    using UnretainedValueToBlobMap = std::unordered_map<FLDict, CBLNewBlob*>;
-
-    static UnretainedValueToBlobMap* sNewBlobs;
 
     string const                _docID;                 // Document ID (never empty)
-    Retained<CBLDatabase> const _db;                    // Database (null for new doc)
+    CBLDatabase* const          _db;                    // Database (null for new doc)
+    Retained<CBLDatabase> const _retainedDB;            // Same as _db, except in a cache entry
     c4::ref<C4Document> const   _c4doc;                 // LiteCore doc (null for new doc)
+    C4Database* const           _c4db;                  // The C4Database _c4doc was read from
     RetainedValue               _properties;            // Properties, initialized lazily
+    Doc                         _jsonDoc;               // Backing store of JSON properties
     ValueToBlobMap              _blobs;
+    std::mutex                  _blobsMutex;            // Protects _blobs
+    Retained<CBLDocument> const _cacheEntry;            // Cache entry I share contents with
     bool const                  _mutable {false};       // True iff I am mutable
+    bool                        _metadataOnly {false};  // Body wasn't read (by an enumerator)
 };
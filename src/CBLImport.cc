@@ -0,0 +1,262 @@
+//
+// CBLImport.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "CBLDatabase_Internal.hh"
+#include "CBLDocument_Internal.hh"
+#include "Internal.hh"
+#include "Util.hh"
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+using namespace fleece;
+using namespace cbl_internal;
+
+
+namespace {
+
+    static constexpr unsigned kDefaultBatchSize = 1000;
+    static const char* const kDefaultDocIDProperty = "_id";
+
+
+    // A fixed-size pool of threads that run tasks from a queue.
+    class WorkerPool {
+    public:
+        explicit WorkerPool(unsigned nThreads) {
+            for (unsigned i = 0; i < nThreads; ++i)
+                _threads.emplace_back([this]{ run(); });
+        }
+
+        ~WorkerPool() {
+            {
+                lock_guard<mutex> lock(_mutex);
+                _stopping = true;
+            }
+            _cond.notify_all();
+            for (auto &thread : _threads)
+                thread.join();
+        }
+
+        template <class T>
+        future<T> submit(function<T()> fn) {
+            // (std::function has to be copyable, so the packaged_task is held by a shared_ptr.)
+            auto task = make_shared<packaged_task<T()>>(move(fn));
+            {
+                lock_guard<mutex> lock(_mutex);
+                _tasks.push_back([task]{ (*task)(); });
+            }
+            _cond.notify_one();
+            return task->get_future();
+        }
+
+    private:
+        void run() {
+            while (true) {
+                function<void()> task;
+                {
+                    unique_lock<mutex> lock(_mutex);
+                    _cond.wait(lock, [this]{ return _stopping || !_tasks.empty(); });
+                    if (_tasks.empty())
+                        return;
+                    task = move(_tasks.front());
+                    _tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        vector<thread>              _threads;
+        mutex                       _mutex;
+        condition_variable          _cond;
+        deque<function<void()>>     _tasks;
+        bool                        _stopping {false};
+    };
+
+
+    // A line of input, parsed into a document.
+    struct ParsedLine {
+        uint64_t                lineNumber;
+        Retained<CBLDocument>   doc;            // null if the line couldn't be parsed
+        C4Error                 error {};
+    };
+
+    using ParsedBatch = vector<ParsedLine>;
+
+
+    // Implementation of CBLDatabase_ImportJSONLines. Batches of lines are read on the calling
+    // thread, parsed into CBLDocuments by the WorkerPool, and saved on the calling thread in the
+    // order they were read.
+    class JSONLinesImporter {
+    public:
+        JSONLinesImporter(CBLDatabase *db, const CBLImportOptions *options)
+        :_db(db)
+        {
+            if (options)
+                _options = *options;
+            if (!_options.docIDProperty)
+                _options.docIDProperty = kDefaultDocIDProperty;
+            if (_options.threadCount == 0)
+                _options.threadCount = max(thread::hardware_concurrency(), 1u);
+            if (_options.batchSize == 0)
+                _options.batchSize = kDefaultBatchSize;
+        }
+
+        int64_t run(const char *path, C4Error *outError) {
+            ifstream in(path);
+            if (!in) {
+                // (ifstream doesn't say why it failed, and errno isn't guaranteed to be set.)
+                if (fileExists(path))
+                    setError(outError, LiteCoreDomain, kC4ErrorCantOpenFile,
+                             "Couldn't open input file"_sl);
+                else
+                    setError(outError, LiteCoreDomain, kC4ErrorNotFound,
+                             "Input file doesn't exist"_sl);
+                return -1;
+            }
+
+            WorkerPool pool(_options.threadCount);
+            deque<future<ParsedBatch>> pending;
+            const size_t maxPending = 2 * _options.threadCount;
+            uint64_t linesRead = 0;
+            bool stopped = false;
+            string line;
+            while (!stopped && in) {
+                // Read a batch of lines and queue it to be parsed:
+                auto lines = make_shared<vector<string>>();
+                lines->reserve(_options.batchSize);
+                uint64_t firstLine = linesRead + 1;
+                while (lines->size() < _options.batchSize && getline(in, line)) {
+                    lines->push_back(move(line));
+                    ++linesRead;
+                }
+                if (lines->empty())
+                    break;
+                slice docIDProperty(_options.docIDProperty);
+                pending.push_back(pool.submit<ParsedBatch>([=]{
+                    return parseLines(*lines, firstLine, docIDProperty);
+                }));
+
+                // Save the oldest batch once enough are in progress:
+                if (pending.size() >= maxPending) {
+                    if (!saveNext(pending, linesRead, &stopped, outError))
+                        return -1;
+                }
+            }
+            if (in.bad()) {
+                // A read error, as opposed to reaching EOF:
+                setError(outError, LiteCoreDomain, kC4ErrorIOError, "Error reading input file"_sl);
+                return -1;
+            }
+            while (!pending.empty() && !stopped) {
+                if (!saveNext(pending, linesRead, &stopped, outError))
+                    return -1;
+            }
+            return int64_t(_docsSaved);
+        }
+
+    private:
+        static ParsedBatch parseLines(const vector<string> &lines,
+                                      uint64_t firstLineNumber,
+                                      slice docIDProperty)
+        {
+            ParsedBatch batch;
+            batch.reserve(lines.size());
+            for (size_t i = 0; i < lines.size(); ++i) {
+                slice json(lines[i]);
+                if (json.size > 0 && json[json.size - 1] == '\r')
+                    json = slice(json.buf, json.size - 1);
+                if (json.size == 0)
+                    continue;
+                ParsedLine parsed;
+                parsed.lineNumber = firstLineNumber + i;
+                Doc doc = Doc::fromJSON(json);
+                Dict root = doc.root().asDict();
+                if (!root) {
+                    setError(&parsed.error, FleeceDomain, kFLJSONError,
+                             "Line is not a JSON object"_sl);
+                } else {
+                    slice docID = root[docIDProperty].asString();
+                    parsed.doc = new CBLDocument(docID ? string(docID).c_str() : nullptr, true);
+                    parsed.doc->setPropertiesFromDoc(doc, &parsed.error);
+                }
+                batch.push_back(move(parsed));
+            }
+            return batch;
+        }
+
+        bool saveNext(deque<future<ParsedBatch>> &pending, uint64_t linesRead,
+                      bool *stopped, C4Error *outError)
+        {
+            ParsedBatch batch = pending.front().get();
+            pending.pop_front();
+
+            vector<CBLDocument*> docs;
+            vector<uint64_t> lineNumbers;
+            docs.reserve(batch.size());
+            lineNumbers.reserve(batch.size());
+            for (auto &parsed : batch) {
+                if (parsed.doc) {
+                    docs.push_back(parsed.doc);
+                    lineNumbers.push_back(parsed.lineNumber);
+                } else {
+                    reportError(parsed.lineNumber, parsed.error);
+                }
+            }
+
+            vector<C4Error> errors(docs.size());
+            if (!CBLDocument::saveAll(_db, docs.data(), docs.size(),
+                                      kCBLConcurrencyControlLastWriteWins,
+                                      errors.data(), outError))
+                return false;
+            for (size_t i = 0; i < docs.size(); ++i) {
+                if (errors[i].code == 0)
+                    ++_docsSaved;
+                else
+                    reportError(lineNumbers[i], errors[i]);
+            }
+
+            if (_options.progress && !_options.progress(_options.context, linesRead, _docsSaved))
+                *stopped = true;
+            return true;
+        }
+
+        void reportError(uint64_t lineNumber, const C4Error &error) {
+            if (_options.error)
+                _options.error(_options.context, lineNumber, external(&error));
+        }
+
+        CBLDatabase* const  _db;
+        CBLImportOptions    _options {};
+        uint64_t            _docsSaved {0};
+    };
+
+}
+
+
+int64_t CBLDatabase_ImportJSONLines(CBLDatabase* db _cbl_nonnull,
+                                    const char *path _cbl_nonnull,
+                                    const CBLImportOptions *options,
+                                    CBLError* outError) CBLAPI
+{
+    return JSONLinesImporter(db, options).run(path, internal(outError));
+}
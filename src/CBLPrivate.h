@@ -39,6 +39,22 @@ uint64_t CBLDatabase_LastSequence(const CBLDatabase* _cbl_nonnull) CBLAPI;
                                         const char* docID _cbl_nonnull,
                                         CBLError* error) CBLAPI;
 
+/** For testing: makes the next chunk commit of the database's auto-batch fail, as though the
+    disk were full. See \ref CBLDatabase_BeginAutoBatch. */
+void CBLDatabase_FailNextChunkCommit(CBLDatabase* _cbl_nonnull) CBLAPI;
+
+/** For testing: reads the integer value of a SQLite PRAGMA, such as "cache_size", from one of
+    the database's connections to its file.
+    @param db  The database.
+    @param reader  The index of a reader connection, or -1 for the main connection.
+    @param pragma  The name of the PRAGMA.
+    @param outValue  The value will be written here.
+    @return  True on success, false if the connection doesn't exist or the PRAGMA failed. */
+bool CBLDatabase_GetPragma(const CBLDatabase* db _cbl_nonnull,
+                           int reader,
+                           const char *pragma _cbl_nonnull,
+                           int64_t *outValue _cbl_nonnull) CBLAPI;
+
 
 
 #ifdef __cplusplus
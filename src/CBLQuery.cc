@@ -25,7 +25,9 @@
 #include "c4Query.h"
 #include "fleece/Fleece.hh"
 #include "fleece/Mutable.hh"
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 using namespace std;
 using namespace fleece;
@@ -43,19 +45,21 @@ public:
              int *outErrPos,
              C4Error* outError)
     :_database(db)
+    ,_language((C4QueryLanguage)language)
     {
-        slice queryString;
-        alloc_slice json;
+        _database->registerQuery(this);
         if (language == kCBLJSONLanguage) {
-            json = convertJSON5(queryCString, outError);
-            if (!json)
+            _queryString = convertJSON5(queryCString, outError);
+            if (!_queryString)
                 return;
-            queryString = json;
         } else {
-            queryString = slice(queryCString);
+            _queryString = alloc_slice(queryCString);
         }
-        _c4query = c4query_new2(internal(db), (C4QueryLanguage)language, queryString,
-                                outErrPos, outError);
+        _c4query = c4query_new2(internal(db), _language, _queryString, outErrPos, outError);
+    }
+
+    ~CBLQuery() {
+        _database->unregisterQuery(this);
     }
 
     bool valid() const                              {return _c4query != nullptr;}
@@ -79,7 +83,8 @@ public:
         return _encodeParameters(enc);
     }
 
-    Retained<CBLResultSet> execute(C4Error* outError);
+    // Runs the query. If `snapshot` is given, it's run on that connection.
+    Retained<CBLResultSet> execute(C4Error* outError, C4Database *snapshot = nullptr);
 
     int columnNamed(slice name) {
         if (!_columnNames) {
@@ -101,6 +106,12 @@ public:
 
     CBLListenerToken* addChangeListener(CBLQueryChangeListener listener, void *context);
 
+    // Frees the copies of the query compiled on other connections, before they're closed.
+    void releaseOtherQueries() {
+        lock_guard<mutex> lock(_otherQueriesMutex);
+        _otherQueries.clear();
+    }
+
     ListenerToken<CBLQueryChangeListener>* getChangeListener(CBLListenerToken *token) {
         return _listeners.find(token);
     }
@@ -115,8 +126,15 @@ private:
         return true;
     }
 
+    C4Query* queryOn(C4Database* _cbl_nonnull, C4Error* outError);
+
     c4::ref<C4Query> _c4query;
     RetainedConst<CBLDatabase> _database;
+    C4QueryLanguage const _language;
+    alloc_slice _queryString;
+    mutex _otherQueriesMutex;
+    // Compiled on each reader or snapshot connection. (Released before they're closed.)
+    unordered_map<C4Database*, c4::ref<C4Query>> _otherQueries;
     alloc_slice _parameters;
     unique_ptr<std::unordered_map<slice, unsigned>> _columnNames;
     Listeners<CBLQueryChangeListener> _listeners;
@@ -159,12 +177,40 @@ private:
 };
 
 
-Retained<CBLResultSet> CBLQuery::execute(C4Error* outError) {
-    auto qe = c4query_run(_c4query, nullptr, nullslice, outError);
+Retained<CBLResultSet> CBLQuery::execute(C4Error* outError, C4Database *snapshot) {
+    C4Query *c4query = _c4query;
+    C4Database *c4db = snapshot;
+    if (!c4db) {
+        int reader = _database->pickReader();
+        if (reader >= 0)
+            c4db = _database->reader(reader);
+    }
+    if (c4db) {
+        c4query = queryOn(c4db, outError);
+        if (!c4query)
+            return nullptr;
+    }
+    auto qe = c4query_run(c4query, nullptr, _parameters, outError);
     return qe ? retained(new CBLResultSet(this, qe)) : nullptr;
 }
 
 
+// Returns the query compiled on one of the database's reader or snapshot connections,
+// compiling it if necessary.
+C4Query* CBLQuery::queryOn(C4Database *c4db, C4Error* outError) {
+    lock_guard<mutex> lock(_otherQueriesMutex);
+    auto &query = _otherQueries[c4db];
+    if (!query)
+        query = c4query_new2(c4db, _language, _queryString, nullptr, outError);
+    return query;
+}
+
+
+void cbl_internal::releaseOtherQueries(CBLQuery *query) {
+    query->releaseOtherQueries();
+}
+
+
 #pragma mark - QUERY LISTENER:
 
 
@@ -191,10 +237,11 @@ namespace cbl_internal {
 
         CBLQueryChangeListener callback() const           {return (CBLQueryChangeListener)_callback.load();}
 
-        void call() {
-            CBLQueryChangeListener cb = callback();
-            if (cb)
-                cb(_context, _query);
+        // this is called indirectly by CBLDatabase::sendNotifications
+        void notify() override {
+            Call c(this);
+            if (c.callback())
+                ((CBLQueryChangeListener)c.callback())(_context, _query);
         }
 
         CBLResultSet* resultSet(CBLError *error) {
@@ -253,6 +300,18 @@ CBLResultSet* CBLQuery_Execute(CBLQuery* query _cbl_nonnull, CBLError* outError)
     return retain(query->execute(internal(outError)).get());
 }
 
+CBLResultSet* CBLSnapshot_ExecuteQuery(const CBLSnapshot* snapshot _cbl_nonnull,
+                                       CBLQuery* query _cbl_nonnull,
+                                       CBLError* outError) CBLAPI
+{
+    if (query->database() != snapshot->db.get()) {
+        setError(internal(outError), LiteCoreDomain, kC4ErrorInvalidParameter,
+                 "Query is not on the snapshot's database"_sl);
+        return nullptr;
+    }
+    return retain(query->execute(internal(outError), snapshot->c4db).get());
+}
+
 FLSliceResult CBLQuery_Explain(CBLQuery* query _cbl_nonnull) CBLAPI {
     return FLSliceResult(query->explain());
 }
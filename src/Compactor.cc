@@ -0,0 +1,167 @@
+//
+// Compactor.cc
+//
+// Copyright (c) 2019 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "Compactor.hh"
+#include "c4.hh"
+#include "c4Private.h"
+#include "fleece/Fleece.hh"
+#include <algorithm>
+#include <string>
+
+using namespace std;
+using namespace fleece;
+
+namespace cbl_internal {
+
+    static constexpr double   kDefaultThreshold = 0.25;
+    static constexpr uint64_t kDefaultMinFreeBytes = 1024 * 1024;
+    static constexpr uint32_t kDefaultMaxMillis = 50;
+    static constexpr uint32_t kDefaultCheckInterval = 60;
+
+    // Number of pages freed by each `PRAGMA incremental_vacuum` within a step:
+    static constexpr unsigned kPagesPerVacuum = 64;
+
+
+    Compactor::Compactor(CBLDatabase *db, const CBLAutoCompactionOptions *options)
+    :_db(db)
+    {
+        if (options)
+            _options = *options;
+        else
+            _options = {};
+        if (_options.fragmentationThreshold <= 0.0)
+            _options.fragmentationThreshold = kDefaultThreshold;
+        if (_options.minFreeBytes == 0)
+            _options.minFreeBytes = kDefaultMinFreeBytes;
+        if (_options.maxMillisPerStep == 0)
+            _options.maxMillisPerStep = kDefaultMaxMillis;
+        if (_options.checkIntervalSeconds == 0)
+            _options.checkIntervalSeconds = kDefaultCheckInterval;
+    }
+
+
+    CBLCompactionStats Compactor::stats() const {
+        lock_guard<mutex> lock(_statsMutex);
+        return _stats;
+    }
+
+
+    BackgroundWorker::clock::time_point Compactor::runTask(C4Database *c4db) {
+        auto idle = clock::now() + chrono::seconds(_options.checkIntervalSeconds);
+        C4Error error;
+        PageCounts before;
+        if (!getPageCounts(c4db, before, &error)) {
+            C4LogToAt(kC4DatabaseLog, kC4LogWarning,
+                      "Compactor couldn't read page counts: %d/%d", error.domain, error.code);
+            return idle;
+        }
+        updateStats(before);
+
+        if (!_compacting) {
+            double fragmentation = before.pageCount ? double(before.freePages) / before.pageCount
+                                                    : 0.0;
+            if (fragmentation < _options.fragmentationThreshold
+                    || before.freePages * before.pageSize < _options.minFreeBytes)
+                return idle;
+            _compacting = true;
+        }
+        if (before.freePages == 0) {
+            // Done with this backlog:
+            _compacting = false;
+            return idle;
+        }
+
+        auto start = clock::now();
+        PageCounts after;
+        if (!vacuumStep(c4db, &error) || !getPageCounts(c4db, after, &error)) {
+            C4LogToAt(kC4DatabaseLog, kC4LogWarning,
+                      "Compactor failed: %d/%d", error.domain, error.code);
+            _compacting = false;
+            return idle;
+        }
+        auto millis = chrono::duration_cast<chrono::milliseconds>(clock::now() - start).count();
+        uint64_t reclaimed = 0;
+        if (after.pageCount < before.pageCount)
+            reclaimed = (before.pageCount - after.pageCount) * before.pageSize;
+
+        updateStats(after);
+        CBLCompactionStats stats;
+        {
+            lock_guard<mutex> lock(_statsMutex);
+            _stats.bytesReclaimed += reclaimed;
+            ++_stats.steps;
+            _stats.maxStepMillis = max(_stats.maxStepMillis, uint32_t(millis));
+            stats = _stats;
+        }
+        if (_options.callback)
+            _options.callback(_options.context, _db, reclaimed, &stats);
+
+        if (after.freePages >= before.freePages) {
+            // No progress; the file probably isn't in incremental auto-vacuum mode:
+            C4LogToAt(kC4DatabaseLog, kC4LogWarning,
+                      "Compactor couldn't reclaim any free pages");
+            _compacting = false;
+            return idle;
+        }
+        // Pause to let other writers in, then continue:
+        return clock::now() + chrono::milliseconds(_options.pauseMillis);
+    }
+
+
+    // Runs `PRAGMA incremental_vacuum` in one transaction until the time limit is reached or
+    // there are no more free pages.
+    bool Compactor::vacuumStep(C4Database *c4db, C4Error *outError) {
+        static const string kVacuum = "PRAGMA incremental_vacuum("
+                                      + to_string(kPagesPerVacuum) + ")";
+        c4::Transaction t(c4db);
+        if (!t.begin(outError))
+            return false;
+        auto deadline = clock::now() + chrono::milliseconds(_options.maxMillisPerStep);
+        PageCounts counts;
+        do {
+            alloc_slice result(c4db_rawQuery(c4db, slice(kVacuum), outError));
+            if (!result || !getPageCounts(c4db, counts, outError))
+                return false;
+        } while (counts.freePages > 0 && clock::now() < deadline && !stopping());
+        return t.commit(outError);
+    }
+
+
+    bool Compactor::getPageCounts(C4Database *c4db, PageCounts &counts, C4Error *outError) {
+        auto pragma = [&](const char *sql, uint64_t &value) -> bool {
+            Doc doc(alloc_slice(c4db_rawQuery(c4db, slice(sql), outError)));
+            if (!doc)
+                return false;
+            value = doc.asArray()[0].asArray()[0].asUnsigned();
+            return true;
+        };
+        return pragma("PRAGMA page_size", counts.pageSize)
+            && pragma("PRAGMA page_count", counts.pageCount)
+            && pragma("PRAGMA freelist_count", counts.freePages);
+    }
+
+
+    void Compactor::updateStats(const PageCounts &counts) {
+        lock_guard<mutex> lock(_statsMutex);
+        _stats.fileSize = counts.pageCount * counts.pageSize;
+        _stats.freeBytes = counts.freePages * counts.pageSize;
+        _stats.fragmentation = counts.pageCount ? double(counts.freePages) / counts.pageCount
+                                                : 0.0;
+    }
+
+}
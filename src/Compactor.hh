@@ -0,0 +1,56 @@
+//
+// Compactor.hh
+//
+// Copyright (c) 2019 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "BackgroundWorker.hh"
+#include "CBLDatabase.h"
+
+
+namespace cbl_internal {
+
+    /** Implements CBLDatabase_StartAutoCompaction: a BackgroundWorker that watches the
+        database file's free pages, and when there are too many, returns them to the filesystem
+        with SQLite's incremental vacuum, in time-limited transactions. Owned by CBLDatabase. */
+    class Compactor : public BackgroundWorker {
+    public:
+        Compactor(CBLDatabase* _cbl_nonnull, const CBLAutoCompactionOptions*);
+
+        CBLCompactionStats stats() const;
+
+        struct PageCounts {
+            uint64_t pageSize, pageCount, freePages;
+        };
+
+        /** Reads the file's page size, page count and free page count. */
+        static bool getPageCounts(C4Database* _cbl_nonnull, PageCounts&, C4Error*);
+
+    protected:
+        clock::time_point runTask(C4Database* _cbl_nonnull) override;
+
+    private:
+        bool vacuumStep(C4Database* _cbl_nonnull, C4Error*);
+        void updateStats(const PageCounts&);
+
+        CBLDatabase* const          _db;
+        CBLAutoCompactionOptions    _options;
+        bool                        _compacting {false};    // True while working on a backlog
+        mutable std::mutex          _statsMutex;
+        CBLCompactionStats          _stats {};
+    };
+
+}
@@ -0,0 +1,132 @@
+//
+// DocumentCache.cc
+//
+// Copyright (c) 2019 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "DocumentCache.hh"
+#include "CBLDocument_Internal.hh"
+
+using namespace std;
+using namespace fleece;
+
+namespace cbl_internal {
+
+    // Approximate memory used by an entry, besides the document body and docID
+    static constexpr size_t kEntryOverhead = 200;
+
+    // Number of invalidated docIDs to remember before forgetting them all. (Then any load that
+    // began before that can't use the cache, which is rare enough not to matter.)
+    static constexpr size_t kMaxInvalidated = 4096;
+
+
+    DocumentCache::DocumentCache(size_t maxBytes)
+    :_maxBytes(maxBytes)
+    { }
+
+
+    DocumentCache::~DocumentCache() = default;
+
+
+    Retained<CBLDocument> DocumentCache::get(slice docID, uint64_t generation) {
+        lock_guard<mutex> lock(_mutex);
+        auto i = _index.find(docID);
+        if (i == _index.end() || _invalidatedSince(docID, generation)) {
+            ++_misses;
+            return nullptr;
+        }
+        ++_hits;
+        _entries.splice(_entries.begin(), _entries, i->second);     // Move to front
+        return i->second->doc;
+    }
+
+
+    uint64_t DocumentCache::generation() const {
+        lock_guard<mutex> lock(_mutex);
+        return _generation;
+    }
+
+
+    void DocumentCache::put(CBLDocument *doc, uint64_t generation) {
+        // Initialize the properties now, since cached documents may be used by multiple threads:
+        (void)doc->properties();
+
+        alloc_slice docID(doc->docID());
+        size_t size = doc->bodySize() + docID.size + kEntryOverhead;
+        if (size > _maxBytes)
+            return;
+
+        lock_guard<mutex> lock(_mutex);
+        if (_invalidatedSince(docID, generation))
+            return;
+        auto i = _index.find(docID);
+        if (i != _index.end())
+            _remove(i->second);
+        _entries.push_front({docID, doc, size});
+        _index.emplace(_entries.front().docID, _entries.begin());
+        _bytes += size;
+        while (_bytes > _maxBytes)
+            _remove(prev(_entries.end()));
+    }
+
+
+    void DocumentCache::remove(slice docID) {
+        lock_guard<mutex> lock(_mutex);
+        ++_generation;
+        if (_invalidated.size() >= kMaxInvalidated) {
+            _invalidated.clear();
+            _invalidatedFloor = _generation;
+        } else {
+            _invalidated[string(docID)] = _generation;
+        }
+        auto i = _index.find(docID);
+        if (i != _index.end())
+            _remove(i->second);
+    }
+
+
+    void DocumentCache::clear() {
+        lock_guard<mutex> lock(_mutex);
+        ++_generation;
+        _invalidated.clear();
+        _invalidatedFloor = _generation;
+        _index.clear();
+        _entries.clear();
+        _bytes = 0;
+    }
+
+
+    // True if `docID` may have changed since `generation` was read.
+    bool DocumentCache::_invalidatedSince(slice docID, uint64_t generation) const {
+        if (generation < _invalidatedFloor)
+            return true;
+        auto i = _invalidated.find(string(docID));
+        return i != _invalidated.end() && i->second > generation;
+    }
+
+
+    void DocumentCache::_remove(EntryList::iterator entry) {
+        _bytes -= entry->size;
+        _index.erase(entry->docID);
+        _entries.erase(entry);
+    }
+
+
+    CBLDocumentCacheStats DocumentCache::stats() const {
+        lock_guard<mutex> lock(_mutex);
+        return {_hits, _misses, _entries.size(), _bytes};
+    }
+
+}
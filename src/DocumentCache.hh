@@ -0,0 +1,86 @@
+//
+// DocumentCache.hh
+//
+// Copyright (c) 2019 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLDatabase.h"
+#include "Internal.hh"
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class CBLDocument;
+
+
+namespace cbl_internal {
+
+    /** An LRU cache of immutable CBLDocuments, keyed by docID and bounded by the total size of
+        the documents' bodies. Owned by CBLDatabase, which calls `remove` for every document that
+        its database observer reports as changed. Thread-safe.
+        The cached documents don't retain the database, since it owns the cache; the database
+        hands out documents that share an entry's contents instead of the entry itself. */
+    class DocumentCache {
+    public:
+        explicit DocumentCache(size_t maxBytes);
+        ~DocumentCache();
+
+        /** Returns the cached document with this ID, or null. Updates the hit/miss counts.
+            A document invalidated since the given generation was read isn't returned, since it
+            may be newer than other documents read since then. */
+        fleece::Retained<CBLDocument> get(fleece::slice docID, uint64_t generation);
+
+        /** Returns a counter that's incremented by every call to `remove` or `clear`. Read it
+            before loading documents, then pass it to `get` and `put`. */
+        uint64_t generation() const;
+
+        /** Adds a document that was just loaded. If that document has been invalidated since the
+            given generation was read, it may be stale, so it's not added. */
+        void put(CBLDocument* _cbl_nonnull, uint64_t generation);
+
+        /** Removes the document with this ID, if it's cached. */
+        void remove(fleece::slice docID);
+
+        /** Removes all documents. */
+        void clear();
+
+        CBLDocumentCacheStats stats() const;
+
+    private:
+        struct Entry {
+            fleece::alloc_slice             docID;
+            fleece::Retained<CBLDocument>   doc;
+            size_t                          size;
+        };
+        using EntryList = std::list<Entry>;
+
+        void _remove(EntryList::iterator);
+        bool _invalidatedSince(fleece::slice docID, uint64_t generation) const;
+
+        size_t const                                            _maxBytes;
+        mutable std::mutex                                      _mutex;
+        EntryList                                               _entries;   // Most recent first
+        std::unordered_map<fleece::slice, EntryList::iterator>  _index;     // Keys point into Entry
+        size_t                                                  _bytes {0};
+        uint64_t                                                _generation {0};
+        std::unordered_map<std::string, uint64_t>               _invalidated; // docID -> generation
+        uint64_t                                                _invalidatedFloor {0};
+        uint64_t                                                _hits {0};
+        uint64_t                                                _misses {0};
+    };
+
+}
@@ -0,0 +1,155 @@
+//
+// ExpirationScheduler.cc
+//
+// Copyright (c) 2019 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "ExpirationScheduler.hh"
+#include "fleece/Fleece.hh"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace fleece;
+
+namespace cbl_internal {
+
+    static constexpr uint32_t kDefaultMaxDocs = 500;
+    static constexpr uint32_t kDefaultMaxMillis = 50;
+
+    // Longest time to sleep, in case an expiration is set through a different CBLDatabase:
+    static constexpr time_t kMaxIdleSecs = 60;
+
+
+    ExpirationScheduler::ExpirationScheduler(const CBLExpirationSchedulerOptions *options)
+    {
+        if (options)
+            _options = *options;
+        else
+            _options = {};
+        if (_options.maxDocsPerTransaction == 0)
+            _options.maxDocsPerTransaction = kDefaultMaxDocs;
+        if (_options.maxMillisPerTransaction == 0)
+            _options.maxMillisPerTransaction = kDefaultMaxMillis;
+    }
+
+
+    CBLExpirationStats ExpirationScheduler::stats() const {
+        lock_guard<mutex> lock(_statsMutex);
+        return _stats;
+    }
+
+
+    BackgroundWorker::clock::time_point ExpirationScheduler::runTask(C4Database *c4db) {
+        time_t now = time(nullptr);
+        time_t next = c4db_nextDocExpiration(c4db);
+        if (next == 0 || next > now) {
+            {
+                lock_guard<mutex> lock(_statsMutex);
+                _stats.nextExpiration = next;
+            }
+            time_t idle = next ? min(next - now, kMaxIdleSecs) : kMaxIdleSecs;
+            return clock::now() + chrono::seconds(idle);
+        }
+        // Some docs have expired. Purge a chunk, then pause to let other writers in:
+        if (purgeChunk(c4db, now))
+            return clock::now() + chrono::milliseconds(_options.pauseMillis);
+        else
+            return clock::now() + chrono::seconds(1);    // Error; don't retry right away
+    }
+
+
+    void ExpirationScheduler::willClose(C4Database*) {
+        _query = nullptr;       // It belongs to the connection that's about to close
+    }
+
+
+    // Purges one transaction's worth of expired docs. Returns false on error.
+    bool ExpirationScheduler::purgeChunk(C4Database *c4db, time_t now) {
+        C4Error error;
+        if (!_query) {
+            // Queries skip deleted docs unless the WHERE clause mentions `_deleted`, so it does,
+            // to find expired tombstones too:
+            string json = "{\"WHAT\": [[\"._id\"], [\"._expiration\"]],"
+                          " \"WHERE\": [\"AND\", [\"<=\", [\"._expiration\"], [\"$now\"]],"
+                          "            [\"OR\", [\"._deleted\"], [\"NOT\", [\"._deleted\"]]]],"
+                          " \"ORDER_BY\": [[\"._expiration\"]],"
+                          " \"LIMIT\": " + to_string(_options.maxDocsPerTransaction) + "}";
+            _query = c4query_new2(c4db, kC4JSONQuery, slice(json), nullptr, &error);
+            if (!_query) {
+                C4LogToAt(kC4DatabaseLog, kC4LogWarning,
+                          "ExpirationScheduler couldn't compile query: %d/%d",
+                          error.domain, error.code);
+                return false;
+            }
+        }
+
+        // Find the IDs of the expired docs, oldest first:
+        Encoder enc;
+        enc.beginDict();
+        enc.writeKey("now"_sl);
+        enc.writeInt(now);
+        enc.endDict();
+        alloc_slice params = enc.finish();
+        c4::ref<C4QueryEnumerator> e = c4query_run(_query, nullptr, params, &error);
+        if (!e)
+            return false;
+        vector<alloc_slice> docIDs;
+        time_t oldest = 0;
+        while (c4queryenum_next(e, &error)) {
+            docIDs.emplace_back(Value(FLArrayIterator_GetValueAt(&e->columns, 0)).asString());
+            if (oldest == 0)
+                oldest = time_t(Value(FLArrayIterator_GetValueAt(&e->columns, 1)).asInt());
+        }
+        if (error.code)
+            return false;
+
+        if (docIDs.empty())
+            return false;           // Already purged through another connection? Wait a while
+
+        auto start = clock::now();
+        int64_t purged = 0;
+        {
+            c4::Transaction t(c4db);
+            if (!t.begin(&error))
+                return false;
+            auto deadline = start + chrono::milliseconds(_options.maxMillisPerTransaction);
+            for (auto &docID : docIDs) {
+                if (purged > 0 && clock::now() >= deadline)
+                    break;
+                if (c4db_purgeDoc(c4db, docID, &error))
+                    ++purged;
+                else if (!(error == C4Error{LiteCoreDomain, kC4ErrorNotFound}))
+                    return false;
+            }
+            if (!t.commit(&error))
+                return false;
+        }
+        auto millis = chrono::duration_cast<chrono::milliseconds>(clock::now() - start).count();
+
+        lock_guard<mutex> lock(_statsMutex);
+        _stats.docsPurged += purged;
+        ++_stats.transactions;
+        if (oldest > 0) {
+            _stats.lagSeconds = now - oldest;
+            _stats.maxLagSeconds = max(_stats.maxLagSeconds, _stats.lagSeconds);
+        }
+        _stats.maxTransactionMillis = max(_stats.maxTransactionMillis, uint32_t(millis));
+        _stats.nextExpiration = now;
+        return true;
+    }
+
+}
@@ -0,0 +1,48 @@
+//
+// ExpirationScheduler.hh
+//
+// Copyright (c) 2019 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "BackgroundWorker.hh"
+#include "CBLDatabase.h"
+#include "c4.hh"
+
+
+namespace cbl_internal {
+
+    /** Implements CBLDatabase_StartExpirationScheduler: a BackgroundWorker that purges expired
+        documents in time- and size-limited transactions. Owned by CBLDatabase. */
+    class ExpirationScheduler : public BackgroundWorker {
+    public:
+        explicit ExpirationScheduler(const CBLExpirationSchedulerOptions*);
+
+        CBLExpirationStats stats() const;
+
+    protected:
+        clock::time_point runTask(C4Database* _cbl_nonnull) override;
+        void willClose(C4Database* _cbl_nonnull) override;
+
+    private:
+        bool purgeChunk(C4Database* _cbl_nonnull, time_t now);
+
+        CBLExpirationSchedulerOptions   _options;
+        c4::ref<C4Query>                _query;         // Finds the IDs of expired docs
+        mutable std::mutex              _statsMutex;
+        CBLExpirationStats              _stats {};
+    };
+
+}
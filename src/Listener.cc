@@ -18,46 +18,184 @@
 
 #include "Listener.hh"
 #include "CBLDatabase.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
 
 using namespace std;
 
 
+// The innermost Call in progress on the current thread
+static thread_local CBLListenerToken::Call* tCurrentCall = nullptr;
+
+// `remove` waits on this for calls to finish. It's shared by all tokens, instead of being a
+// member, because a finishing Call can't touch its token after decrementing its count: the
+// token may be freed as soon as `remove` returns.
+static mutex sCallsMutex;
+static condition_variable sCallsFinished;
+static atomic<unsigned> sWaitingRemovers {0};
+
+
+CBLListenerToken::Call::Call(CBLListenerToken *token)
+:_token(token)
+,_outer(tCurrentCall)
+{
+    // Count this call before loading the callback: if `remove` cleared it after this load,
+    // it will see the count and wait.
+    ++token->_activeCalls;
+    _callback = token->_callback.load();
+    tCurrentCall = this;
+}
+
+
+CBLListenerToken::Call::~Call() {
+    tCurrentCall = _outer;
+    --_token->_activeCalls;
+    // A `remove` that registers as waiting after this check will see the decremented count.
+    // One that registered before it is either waiting, or will check the count once it has the
+    // mutex, so taking the mutex before notifying can't miss it.
+    if (sWaitingRemovers > 0) {
+        lock_guard<mutex> lock(sCallsMutex);
+        sCallsFinished.notify_all();
+    }
+}
+
+
 void CBLListenerToken::remove() {
     auto oldOwner = _owner;
     assert(oldOwner);
     _callback = nullptr;
     _owner = nullptr;
     oldOwner->remove(this);
+
+    unsigned callsOnThisThread = 0;
+    for (auto call = tCurrentCall; call; call = call->_outer) {
+        if (call->_token == this)
+            ++callsOnThisThread;
+    }
+    if (_activeCalls > callsOnThisThread) {
+        ++sWaitingRemovers;
+        unique_lock<mutex> lock(sCallsMutex);
+        sCallsFinished.wait(lock, [&] {return _activeCalls <= callsOnThisThread;});
+        --sWaitingRemovers;
+    }
+}
+
+
+void CBLListenerToken::notify() {
+    // A subclass posted a notification to the queue without overriding this method.
+    C4LogToAt(kC4DatabaseLog, kC4LogWarning,
+              "Listener token %p doesn't implement notify(); notification dropped", this);
+    assert(false);
+}
+
+
+void ListenersBase::add(CBLListenerToken *t) {
+    t->addedTo(this);
+    lock_guard<mutex> lock(_mutex);
+    _tokens.emplace(t, _order.emplace(_order.end(), t));
+    ++_count;
+    changed();
+}
+
+
+void ListenersBase::remove(CBLListenerToken *t) {
+    lock_guard<mutex> lock(_mutex);
+    auto i = _tokens.find(t);
+    assert(i != _tokens.end());
+    if (i != _tokens.end()) {
+        _order.erase(i->second);
+        _tokens.erase(i);
+        --_count;
+        changed();
+    }
+}
+
+
+void ListenersBase::clear() {
+    lock_guard<mutex> lock(_mutex);
+    _tokens.clear();
+    _order.clear();
+    _count = 0;
+    changed();
+}
+
+
+bool ListenersBase::contains(CBLListenerToken *t) const {
+    lock_guard<mutex> lock(_mutex);
+    return _tokens.find(t) != _tokens.end();
 }
 
 
+// Invalidates the snapshot; the next call to `tokens` will rebuild it. (Must hold _mutex.)
+void ListenersBase::changed() {
+    atomic_store(&_snapshot, shared_ptr<const TokenList>());
+}
+
+
+shared_ptr<const ListenersBase::TokenList> ListenersBase::tokens() const {
+    auto snapshot = atomic_load(&_snapshot);
+    if (!snapshot) {
+        lock_guard<mutex> lock(_mutex);
+        snapshot = atomic_load(&_snapshot);
+        if (!snapshot) {
+            snapshot = make_shared<TokenList>(_order.begin(), _order.end());
+            atomic_store(&_snapshot, snapshot);
+        }
+    }
+    return snapshot;
+}
+
+
+// Initial capacity of a NotificationQueue's ring buffer
+static constexpr size_t kInitialQueueCapacity = 64;
+
+
 NotificationQueue::NotificationQueue(CBLDatabase *database _cbl_nonnull)
 :_database(database)
 ,_state(State())
-{ }
+{
+    _state.use([](State &state) {
+        state.ring.resize(kInitialQueueCapacity);
+    });
+}
+
 
 void NotificationQueue::setCallback(CBLNotificationsReadyCallback callback, void *context) {
-    auto pending = _state.use<Notifications>([&](State &state) {
+    _state.use([&](State &state) {
         state.callback = callback;
         state.context = context;
-        return callback ? nullptr : move(state.queue);
     });
-    call(pending);
+    if (!callback)
+        notifyAll();                            // deliver anything that was queued
 }
 
 
 void NotificationQueue::add(Notification notification) {
+    add(Entry{nullptr, move(notification)});
+}
+
+
+void NotificationQueue::add(CBLListenerToken *token) {
+    add(Entry{token, nullptr});
+}
+
+
+void NotificationQueue::add(Entry &&entry) {
     bool notifyNow = false;
     CBLNotificationsReadyCallback readyCallback = nullptr;
     void* readyContext;
 
     _state.use([&](State &state) {
         if (state.callback) {
-            bool first = !state.queue;
-            if (first)
-                state.queue.reset( new vector<Notification> );
-            state.queue->push_back(notification);
-            if (first) {
+            if (entry.token) {
+                if (entry.token->_queued)
+                    return;                     // Already queued; coalesce
+                entry.token->_queued = true;
+            }
+            state.push(move(entry));
+            if (!state.readyCalled) {
+                state.readyCalled = true;
                 readyCallback = state.callback;
                 readyContext = state.context;
             }
@@ -67,23 +205,61 @@ void NotificationQueue::add(Notification notification) {
     });
 
     if (notifyNow)
-        notification();                         // immediate notification
+        call(entry);                            // immediate notification
     else if (readyCallback)
         readyCallback(readyContext, _database); // notify that notifications are queued
 }
 
 
 void NotificationQueue::notifyAll() {
-    auto queue = _state.use<Notifications>([&](State &state) {
-        return move(state.queue);
+    // Only deliver the entries queued so far; any added meanwhile will trigger a new callback.
+    size_t n = _state.use<size_t>([](State &state) {
+        state.readyCalled = false;
+        return state.count;
     });
-    call(queue);
+    for (; n > 0; --n) {
+        Entry entry;
+        bool got = _state.use<bool>([&](State &state) {
+            if (state.count == 0)
+                return false;
+            entry = state.pop();
+            if (entry.token)
+                entry.token->_queued = false;   // a new notification must be queued again
+            return true;
+        });
+        if (!got)
+            break;
+        call(entry);
+    }
+}
+
+
+void NotificationQueue::call(Entry &entry) {
+    if (entry.token)
+        entry.token->notify();
+    else
+        entry.function();
 }
 
 
-void NotificationQueue::call(const Notifications &queue) {
-    if (queue) {
-        for (Notification &n : *queue)
-            n();
+void NotificationQueue::State::push(Entry &&entry) {
+    if (count == ring.size()) {
+        // Full: grow the buffer, unwrapping the entries so they start at index 0
+        vector<Entry> newRing(max(2 * ring.size(), kInitialQueueCapacity));
+        for (size_t i = 0; i < count; ++i)
+            newRing[i] = move(ring[(head + i) % ring.size()]);
+        ring.swap(newRing);
+        head = 0;
     }
+    ring[(head + count) % ring.size()] = move(entry);
+    ++count;
+}
+
+
+NotificationQueue::Entry NotificationQueue::State::pop() {
+    Entry entry = move(ring[head]);
+    ring[head] = Entry();
+    head = (head + 1) % ring.size();
+    --count;
+    return entry;
 }
@@ -21,12 +21,16 @@
 #include "Internal.hh"
 #include <access_lock.hh>
 #include <atomic>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 
 namespace cbl_internal {
     class ListenersBase;
+    class NotificationQueue;
 }
 
 
@@ -45,13 +49,43 @@ public:
         _owner = owner;
     }
 
-    /** Called by `CBLListener_Remove` */
-    void remove();
+    /** Called by `CBLListener_Remove`. After clearing the callback, it waits for calls to it
+        that are in progress on other threads, so the listener won't be called after this
+        returns. (Calls on the current thread, i.e. a listener removing itself, aren't waited
+        for, since they can't finish first.) */
+    virtual void remove();
+
+    /** Called by NotificationQueue to deliver a notification posted with `add(CBLListenerToken*)`.
+        Subclasses that use that must override this to call their listener; the default just
+        logs a warning, since there's no way to know the listener's parameters. */
+    virtual void notify();
+
+    /** Brackets a call to the listener, so that `remove` can wait for it to finish. If the
+        token has been removed, `callback()` is null and the listener must not be called. */
+    class Call {
+    public:
+        explicit Call(CBLListenerToken* _cbl_nonnull);
+        ~Call();
+        const void* callback() const            {return _callback;}
+    private:
+        Call(const Call&) =delete;
+        Call& operator=(const Call&) =delete;
+        friend struct CBLListenerToken;
+
+        CBLListenerToken* const _token;
+        Call* const _outer;                     // Enclosing Call on this thread, if any
+        const void* _callback;
+    };
 
 protected:
     std::atomic<const void*> _callback;          // Really a C fn pointer
     void* _context;
     cbl_internal::ListenersBase* _owner {nullptr};
+
+private:
+    friend class cbl_internal::NotificationQueue;
+    bool _queued {false};                       // True while in a NotificationQueue
+    std::atomic<unsigned> _activeCalls {0};     // Number of Call objects in existence
 };
 
 
@@ -69,46 +103,47 @@ namespace cbl_internal {
 
             template <class... Args>
         void call(Args... args) {
-            LISTENER cb = callback();
-            if (cb)
-                cb(_context, args...);
+            Call c(this);
+            if (c.callback())
+                ((LISTENER)c.callback())(_context, args...);
         }
     };
 
 
 
-    /** Manages a set of CBLListenerTokens. */
+    /** Manages a set of CBLListenerTokens. Thread-safe.
+        Adding, removing and looking up a token take constant time. Listeners are called from
+        an immutable snapshot of the token list, which is rebuilt (copy-on-write) only after the
+        set changes, so dispatch doesn't take a lock and tokens can be added or removed while
+        listeners are being called. A token removed during dispatch may still be in the
+        snapshot, but its callback has been cleared, so it won't be called. The snapshot is
+        rebuilt by copying a list kept in registration order, in linear time. */
     class ListenersBase {
     public:
-        void add(CBLListenerToken* t _cbl_nonnull) {
-            _tokens.emplace_back(t);
-            t->addedTo(this);
-        }
+        using TokenList = std::vector<fleece::Retained<CBLListenerToken>>;
 
-        void remove(CBLListenerToken* t _cbl_nonnull) {
-            for (auto i = _tokens.begin(); i != _tokens.end(); ++i) {
-                if (i->get() == t) {
-                    _tokens.erase(i);
-                    return;
-                }
-            }
-            assert(false);
-        }
+        void add(CBLListenerToken* _cbl_nonnull);
+        void remove(CBLListenerToken* _cbl_nonnull);
+        void clear();
 
-        void clear() {
-            _tokens.clear();
-        }
+        bool empty() const                                      {return _count == 0;}
 
-        bool contains(CBLListenerToken *token _cbl_nonnull) const {
-            for (auto &tok : _tokens) {
-                if (tok == token)
-                    return true;
-            }
-            return false;
-        }
+        bool contains(CBLListenerToken* _cbl_nonnull) const;
 
     protected:
-        std::vector<fleece::Retained<CBLListenerToken>> _tokens;
+        /** Returns the current tokens, in the order they were added. */
+        std::shared_ptr<const TokenList> tokens() const;
+
+    private:
+        using TokenOrder = std::list<fleece::Retained<CBLListenerToken>>;
+
+        void changed();
+
+        mutable std::mutex _mutex;                              // Guards all but _snapshot
+        TokenOrder _order;                                      // Tokens in registration order
+        std::unordered_map<CBLListenerToken*, TokenOrder::iterator> _tokens;  // Index of _order
+        std::atomic<size_t> _count {0};
+        mutable std::shared_ptr<const TokenList> _snapshot;     // Null if out of date
     };
 
 
@@ -124,6 +159,7 @@ namespace cbl_internal {
 
         void add(ListenerToken<LISTENER> *token)                {ListenersBase::add(token);}
         void clear()                                            {ListenersBase::clear();}
+        bool empty() const                                      {return ListenersBase::empty();}
 
         ListenerToken<LISTENER>* find(CBLListenerToken *token) {
             return contains(token) ? (ListenerToken<LISTENER>*) token : nullptr;
@@ -131,7 +167,8 @@ namespace cbl_internal {
 
             template <class... Args>
         void call(Args... args) {
-            for (auto &lp : _tokens)
+            auto snapshot = tokens();
+            for (auto &lp : *snapshot)
                 ((ListenerToken<LISTENER>*)lp.get())->call(args...);
         }
     };
@@ -140,7 +177,10 @@ namespace cbl_internal {
     using Notification = std::function<void()>;
 
 
-    /** Manages a queue of pending calls to listeners. Owned by CBLDatabase. */
+    /** Manages a queue of pending calls to listeners. Owned by CBLDatabase.
+        The queue is a ring buffer, which only grows if it fills up. Notifications posted by a
+        listener token are coalesced: a token that's already in the queue isn't added again, so
+        the queue can't hold more than one entry per token no matter how often it's notified. */
     class NotificationQueue {
     public:
         NotificationQueue(CBLDatabase* _cbl_nonnull);
@@ -153,21 +193,34 @@ namespace cbl_internal {
             If there is no callback, it calls the notification directly. */
         void add(Notification);
 
-        /** Calls all queued notifications and clears the queue. */
+        /** Like `add(Notification)`, but the notification calls the token's `notify` method.
+            If the token is already in the queue, nothing happens. */
+        void add(CBLListenerToken* _cbl_nonnull);
+
+        /** Calls all queued notifications and removes them from the queue. */
         void notifyAll();
 
 
     private:
-        using Notifications = std::unique_ptr<std::vector<Notification>>;
+        struct Entry {
+            fleece::Retained<CBLListenerToken> token;   // A token to notify, or else
+            Notification function;                      // a function to call
+        };
 
-        void call(const Notifications&);
-        
         struct State {
             CBLNotificationsReadyCallback callback {nullptr};
             void* context;
-            Notifications queue;
+            bool readyCalled {false};       // Has callback been called since the last notifyAll?
+            std::vector<Entry> ring;        // Ring buffer of queued entries
+            size_t head {0}, count {0};
+
+            void push(Entry&&);
+            Entry pop();
         };
 
+        void add(Entry&&);
+        static void call(Entry&);
+
         CBLDatabase* const _database;
         litecore::access_lock<State> _state;
     };
@@ -18,8 +18,17 @@
 
 #include "Util.hh"
 #include "fleece/Fleece.h"
+#include <errno.h>
 #include <stdio.h>
 #include <string>
+#include <sys/stat.h>
+
+#ifdef _MSC_VER
+#include <direct.h>
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
 
 using namespace fleece;
 
@@ -77,4 +86,99 @@ namespace cbl_internal {
             *outError = c4error_make(domain, code, message);
     }
 
+
+
+#pragma mark - FILESYSTEM:
+
+
+#ifdef _MSC_VER
+
+    bool fileExists(const std::string &path) {
+        struct _stat64 st;
+        return _stat64(path.c_str(), &st) == 0;
+    }
+
+
+    bool getFileSize(const std::string &path, uint64_t &outSize) {
+        struct _stat64 st;
+        if (_stat64(path.c_str(), &st) != 0)
+            return false;
+        outSize = uint64_t(st.st_size);
+        return true;
+    }
+
+
+    bool makeDirectory(const std::string &path) {
+        return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+    }
+
+
+    bool forEachFile(const std::string &dir,
+                     const std::function<void(const char *name, uint64_t size)> &callback)
+    {
+        struct __finddata64_t entry;
+        intptr_t handle = _findfirst64((dir + "\\*").c_str(), &entry);
+        if (handle == -1)
+            return false;
+        do {
+            if (entry.name[0] != '.' && !(entry.attrib & _A_SUBDIR))
+                callback(entry.name, uint64_t(entry.size));
+        } while (_findnext64(handle, &entry) == 0);
+        _findclose(handle);
+        return true;
+    }
+
+
+    bool replaceFile(const std::string &from, const std::string &to) {
+        if (::remove(to.c_str()) != 0 && errno != ENOENT)
+            return false;
+        return ::rename(from.c_str(), to.c_str()) == 0;
+    }
+
+#else
+
+    bool fileExists(const std::string &path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0;
+    }
+
+
+    bool getFileSize(const std::string &path, uint64_t &outSize) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return false;
+        outSize = uint64_t(st.st_size);
+        return true;
+    }
+
+
+    bool makeDirectory(const std::string &path) {
+        return mkdir(path.c_str(), 0700) == 0 || errno == EEXIST;
+    }
+
+
+    bool forEachFile(const std::string &dir,
+                     const std::function<void(const char *name, uint64_t size)> &callback)
+    {
+        DIR *d = opendir(dir.c_str());
+        if (!d)
+            return false;
+        while (struct dirent *entry = readdir(d)) {
+            if (entry->d_name[0] == '.')
+                continue;
+            struct stat st;
+            if (stat((dir + "/" + entry->d_name).c_str(), &st) == 0 && S_ISREG(st.st_mode))
+                callback(entry->d_name, uint64_t(st.st_size));
+        }
+        closedir(d);
+        return true;
+    }
+
+
+    bool replaceFile(const std::string &from, const std::string &to) {
+        return ::rename(from.c_str(), to.c_str()) == 0;
+    }
+
+#endif
+
 }
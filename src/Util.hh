@@ -20,6 +20,7 @@
 #include "CBLBase.h"
 #include "fleece/slice.hh"
 #include "c4Base.h"
+#include <functional>
 #include <string>
 
 namespace cbl_internal {
@@ -36,4 +37,25 @@ namespace cbl_internal {
     fleece::alloc_slice convertJSON5(const char *json5, C4Error *outError);
 
     void setError(C4Error* outError, C4ErrorDomain domain, int code, C4String message);
+
+
+    // Portable filesystem helpers. On failure they return false and leave the reason in `errno`.
+
+    /** Returns true if a file or directory exists at `path`. */
+    bool fileExists(const std::string &path);
+
+    /** Gets the size of a file, as a 64-bit value on every platform. */
+    bool getFileSize(const std::string &path, uint64_t &outSize);
+
+    /** Creates a directory, readable only by the owner. Succeeds if it already exists. */
+    bool makeDirectory(const std::string &path);
+
+    /** Calls `callback` with the name and size of each regular file in directory `dir`,
+        skipping ones whose names start with '.'. Returns false if the directory can't be read. */
+    bool forEachFile(const std::string &dir,
+                     const std::function<void(const char *name, uint64_t size)> &callback);
+
+    /** Renames file `from` to `to`, replacing any existing file. This is atomic except on
+        Windows, where the existing file has to be deleted first. */
+    bool replaceFile(const std::string &from, const std::string &to);
 }
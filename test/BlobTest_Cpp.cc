@@ -123,3 +123,49 @@ TEST_CASE_METHOD(CBLTest_Cpp, "C++ Blob in mutable doc") {
     REQUIRE(blob);
     CHECK((FLDict)blob.properties() == (FLDict)props);
 }
+
+
+TEST_CASE_METHOD(CBLTest_Cpp, "C++ Blob stored with SetBlob") {
+    Blob blob(kBlobContentType, kBlobContents);
+    string where;
+    {
+        MutableDocument doc("blobbo");
+        SECTION("In document properties") {
+            FLMutableDict_SetBlob(doc.properties(), "picture"_sl, blob.ref());
+            where = "properties";
+        }
+        SECTION("In nested dict") {
+            MutableDict album = MutableDict::newDict();
+            doc["album"] = album;
+            FLMutableDict_SetBlob(album, "picture"_sl, blob.ref());
+            where = "dict";
+        }
+        SECTION("In nested array") {
+            MutableArray pictures = MutableArray::newArray();
+            FLMutableArray_Resize(pictures, 1);
+            doc["pictures"] = pictures;
+            FLMutableArray_SetBlob(pictures, 0, blob.ref());
+            where = "array";
+        }
+        SECTION("Copied from another document") {
+            MutableDocument other("other");
+            FLMutableDict_SetBlob(other.properties(), "picture"_sl, blob.ref());
+            doc["picture"] = Value(FLDict_Get(other.properties(), "picture"_sl));
+            where = "properties";
+        }
+        db.saveDocument(doc);
+    }
+
+    Document doc = db.getDocument("blobbo");
+    Dict props;
+    if (where == "dict")
+        props = doc["album"].asDict()["picture"].asDict();
+    else if (where == "array")
+        props = doc["pictures"].asArray()[0].asDict();
+    else
+        props = doc["picture"].asDict();
+    checkBlob(props);
+    Blob savedBlob(props);
+    REQUIRE(savedBlob);
+    CHECK(savedBlob.loadContent() == kBlobContents);
+}
@@ -17,9 +17,18 @@
 //
 
 #include "CBLTest.hh"
+#include "CBLPrivate.h"
 #include "fleece/Fleece.hh"
 #include "fleece/Mutable.hh"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <stdio.h>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace std;
 using namespace fleece;
@@ -90,6 +99,62 @@ TEST_CASE_METHOD(CBLTest, "Save Document With Property") {
 }
 
 
+static bool appendJSON(void *context, const void *bytes, size_t size) {
+    ((string*)context)->append((const char*)bytes, size);
+    return true;
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Write Properties As JSON") {
+    CBLDocument* doc = CBLDocument_New("foo");
+    MutableDict props = CBLDocument_MutableProperties(doc);
+    props["greeting"_sl] = "Howdy!"_sl;
+
+    FLSliceResult json = CBLDocument_PropertiesToJSON(doc);
+    CHECK(slice(json) == "{\"greeting\":\"Howdy!\"}"_sl);
+    FLSliceResult_Release(json);
+
+    CBLError error;
+    const CBLDocument *saved = CBLDatabase_SaveDocument(db, doc, kCBLConcurrencyControlFailOnConflict, &error);
+    REQUIRE(saved);
+    string output;
+    CHECK(CBLDocument_WritePropertiesJSON(saved, appendJSON, &output));
+    CHECK(output == "{\"greeting\":\"Howdy!\"}");
+    CBLDocument_Release(saved);
+    CBLDocument_Release(doc);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Save Multiple Documents") {
+    CBLDocument* docs[3];
+    docs[0] = CBLDocument_New("foo");
+    docs[1] = CBLDocument_New("bar");
+    docs[2] = CBLDocument_New("foo");       // will conflict with docs[0]
+    for (int i = 0; i < 3; ++i) {
+        MutableDict props = CBLDocument_MutableProperties(docs[i]);
+        props["n"_sl] = i;
+    }
+
+    CBLError errors[3];
+    CBLError error;
+    CHECK(CBLDatabase_SaveDocuments(db, docs, 3, kCBLConcurrencyControlFailOnConflict,
+                                    errors, &error));
+    CHECK(errors[0].code == 0);
+    CHECK(errors[1].code == 0);
+    CHECK(errors[2].domain == CBLDomain);
+    CHECK(errors[2].code == CBLErrorConflict);
+    CHECK(CBLDatabase_Count(db) == 2);
+
+    const CBLDocument *saved = CBLDatabase_GetDocument(db, "foo");
+    REQUIRE(saved);
+    CHECK(string(CBLDocument_PropertiesAsJSON(saved)) == "{\"n\":0}");
+    CBLDocument_Release(saved);
+
+    for (int i = 0; i < 3; ++i)
+        CBLDocument_Release(docs[i]);
+}
+
+
 static void createDocument(CBLDatabase *db, const char *docID,
                            const char *property, const char *value)
 {
@@ -105,6 +170,654 @@ static void createDocument(CBLDatabase *db, const char *docID,
 }
 
 
+namespace {
+    struct AsyncSaveResults {
+        mutex               resultsMutex;
+        condition_variable  cond;
+        vector<int>         errorCodes;         // 0 for success
+        bool                consistent {true};  // Was the error given iff there's no doc?
+
+        bool waitFor(size_t count) {
+            unique_lock<mutex> lock(resultsMutex);
+            return cond.wait_for(lock, chrono::seconds(10), [&]{return errorCodes.size() >= count;});
+        }
+    };
+}
+
+static void saveCompleted(void *context, const CBLDocument *savedDoc, const CBLError *error) {
+    // (This runs on the writer thread, so it can't use Catch assertions.)
+    auto results = (AsyncSaveResults*)context;
+    lock_guard<mutex> lock(results->resultsMutex);
+    if ((savedDoc == nullptr) != (error != nullptr))
+        results->consistent = false;
+    results->errorCodes.push_back(error ? error->code : 0);
+    results->cond.notify_all();
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Save Document Async") {
+    AsyncSaveResults results;
+    CBLError error;
+    for (int i = 0; i < 10; ++i) {
+        string docID = "doc-" + to_string(i);
+        CBLDocument *doc = CBLDocument_New(docID.c_str());
+        MutableDict props = CBLDocument_MutableProperties(doc);
+        props["n"_sl] = i;
+        REQUIRE(CBLDatabase_SaveDocumentAsync(db, doc, kCBLConcurrencyControlFailOnConflict,
+                                              saveCompleted, &results, &error));
+        CBLDocument_Release(doc);
+    }
+    REQUIRE(results.waitFor(10));
+    CHECK(results.errorCodes == vector<int>(10, 0));
+    CHECK(CBLDatabase_Count(db) == 10);
+
+    // Saving an out-of-date document fails with a conflict:
+    CBLDocument *stale = CBLDatabase_GetMutableDocument(db, "doc-0");
+    CBLDocument *current = CBLDatabase_GetMutableDocument(db, "doc-0");
+    MutableDict(CBLDocument_MutableProperties(current))["n"_sl] = 100;
+    const CBLDocument *saved = CBLDatabase_SaveDocument(db, current,
+                                                        kCBLConcurrencyControlFailOnConflict, &error);
+    REQUIRE(saved);
+    CBLDocument_Release(saved);
+    CBLDocument_Release(current);
+
+    MutableDict(CBLDocument_MutableProperties(stale))["n"_sl] = -1;
+    REQUIRE(CBLDatabase_SaveDocumentAsync(db, stale, kCBLConcurrencyControlFailOnConflict,
+                                          saveCompleted, &results, &error));
+    REQUIRE(results.waitFor(11));
+    CHECK(results.errorCodes[10] == CBLErrorConflict);
+
+    // ...unless last-write-wins:
+    REQUIRE(CBLDatabase_SaveDocumentAsync(db, stale, kCBLConcurrencyControlLastWriteWins,
+                                          saveCompleted, &results, &error));
+    REQUIRE(results.waitFor(12));
+    CHECK(results.errorCodes[11] == 0);
+    CHECK(results.consistent);
+    CBLDocument_Release(stale);
+
+    const CBLDocument *doc = CBLDatabase_GetDocument(db, "doc-0");
+    REQUIRE(doc);
+    CHECK(Dict(CBLDocument_Properties(doc))["n"_sl].asInt() == -1);
+    CBLDocument_Release(doc);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Document Info") {
+    createDocument(db, "foo", "greeting", "Howdy!");
+
+    CBLDocumentInfo info;
+    CBLError error;
+    REQUIRE(CBLDatabase_GetDocumentInfo(db, "foo", 0, &info, &error));
+    CHECK(slice(info.docID) == "foo"_sl);
+    CHECK(info.sequence == 1);
+    CHECK((info.flags & kCBLDocumentFlagsExists) != 0);
+    CHECK((info.flags & kCBLDocumentFlagsDeleted) == 0);
+    CHECK(info.expiration == 0);
+    CHECK(info.bodySize == 0);
+
+    time_t expiration = time(nullptr) + 3600;
+    REQUIRE(CBLDatabase_SetDocumentExpiration(db, "foo", expiration, &error));
+    REQUIRE(CBLDatabase_GetDocumentInfo(db, "foo",
+                                        kCBLDocumentInfoBodySize | kCBLDocumentInfoExpiration,
+                                        &info, &error));
+    CHECK(info.expiration == expiration);
+    CHECK(info.bodySize > 0);
+
+    CHECK(!CBLDatabase_GetDocumentInfo(db, "missing", 0, &info, &error));
+    CHECK(error.code == 0);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Document Cache") {
+    createDocument(db, "foo", "greeting", "Howdy!");
+
+    // Open another instance of the database, with a cache:
+    CBLDatabaseConfiguration config = kDatabaseConfiguration;
+    config.documentCacheSize = 100000;
+    CBLError error;
+    CBLDatabase *cachedDB = CBLDatabase_Open(kDatabaseName, &config, &error);
+    REQUIRE(cachedDB);
+    CHECK(CBLDatabase_Config(cachedDB).documentCacheSize == 100000);
+
+    const CBLDocument *doc1 = CBLDatabase_GetDocument(cachedDB, "foo");
+    const CBLDocument *doc2 = CBLDatabase_GetDocument(cachedDB, "foo");
+    REQUIRE(doc1);
+    REQUIRE(doc2);
+    CHECK(CBLDocument_Properties(doc2) == CBLDocument_Properties(doc1));   // shared from cache
+    CHECK(CBLDatabase_GetDocument(cachedDB, "missing") == nullptr);
+    CBLDocumentCacheStats stats = CBLDatabase_DocumentCacheStats(cachedDB);
+    CHECK(stats.hits == 1);
+    CHECK(stats.misses == 2);
+    CHECK(stats.count == 1);
+    CHECK(stats.bytes > 0);
+    CBLDocument_Release(doc1);
+    CBLDocument_Release(doc2);
+
+    // Updating the doc through the other instance evicts it from the cache:
+    CBLDocument *mdoc = CBLDatabase_GetMutableDocument(db, "foo");
+    MutableDict props = CBLDocument_MutableProperties(mdoc);
+    props["greeting"_sl] = "Hi there"_sl;
+    const CBLDocument *saved = CBLDatabase_SaveDocument(db, mdoc, kCBLConcurrencyControlFailOnConflict,
+                                                        &error);
+    REQUIRE(saved);
+    CBLDocument_Release(saved);
+    CBLDocument_Release(mdoc);
+    CHECK(CBLDatabase_DocumentCacheStats(cachedDB).count == 0);
+
+    doc1 = CBLDatabase_GetDocument(cachedDB, "foo");
+    REQUIRE(doc1);
+    CHECK(Dict(CBLDocument_Properties(doc1))["greeting"_sl].asString() == "Hi there"_sl);
+    CHECK(CBLDatabase_DocumentCacheStats(cachedDB).misses == 3);
+    CBLDocument_Release(doc1);
+
+    // The main instance has no cache:
+    CHECK(CBLDatabase_DocumentCacheStats(db).misses == 0);
+
+    CHECK(CBLDatabase_Close(cachedDB, &error));
+    CBLDatabase_Release(cachedDB);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Document Cache Doesn't Leak Database") {
+    createDocument(db, "foo", "greeting", "Howdy!");
+    unsigned instancesBefore = CBL_InstanceCount();
+
+    // Fill a database's cache, then release it without closing it:
+    CBLDatabaseConfiguration config = kDatabaseConfiguration;
+    config.documentCacheSize = 100000;
+    CBLError error;
+    CBLDatabase *cachedDB = CBLDatabase_Open(kDatabaseName, &config, &error);
+    REQUIRE(cachedDB);
+    const CBLDocument *doc = CBLDatabase_GetDocument(cachedDB, "foo");
+    REQUIRE(doc);
+    CBLDocument_Release(doc);
+    CHECK(CBLDatabase_DocumentCacheStats(cachedDB).count == 1);
+
+    // A document from the cache keeps the database alive until it's released:
+    doc = CBLDatabase_GetDocument(cachedDB, "foo");
+    REQUIRE(doc);
+    CBLDatabase_Release(cachedDB);
+    CHECK(Dict(CBLDocument_Properties(doc))["greeting"_sl].asString() == "Howdy!"_sl);
+    CBLDocument_Release(doc);
+
+    CHECK(CBL_InstanceCount() == instancesBefore);
+}
+
+
+static bool batchProgress(void *context, size_t docsProcessed, size_t docsRemoved) {
+    auto calls = (vector<pair<size_t,size_t>>*)context;
+    calls->push_back({docsProcessed, docsRemoved});
+    return calls->size() < 2;       // Stop after the 2nd chunk
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Delete and Purge Multiple Documents") {
+    for (int i = 0; i < 10; ++i)
+        createDocument(db, ("doc-" + to_string(i)).c_str(), "n", "x");
+
+    const char* deleteIDs[] = {"doc-0", "missing", "doc-1", "doc-2"};
+    vector<pair<size_t,size_t>> calls;
+    CBLError error;
+    CHECK(CBLDatabase_DeleteDocumentsByID(db, deleteIDs, 4, 2, batchProgress, &calls, &error) == 3);
+    CHECK((calls == vector<pair<size_t,size_t>>{{2, 1}, {4, 3}}));
+    CHECK(CBLDatabase_Count(db) == 7);
+
+    // Deleting again does nothing:
+    CHECK(CBLDatabase_DeleteDocumentsByID(db, deleteIDs, 4, 0, nullptr, nullptr, &error) == 0);
+
+    // Purging stops when the callback returns false:
+    const char* purgeIDs[] = {"doc-3", "doc-4", "doc-5", "doc-6", "doc-7", "doc-8"};
+    calls.clear();
+    CHECK(CBLDatabase_PurgeDocumentsByID(db, purgeIDs, 6, 2, batchProgress, &calls, &error) == 4);
+    CHECK((calls == vector<pair<size_t,size_t>>{{2, 2}, {4, 4}}));
+    CHECK(CBLDatabase_Count(db) == 3);
+    const CBLDocument *doc = CBLDatabase_GetDocument(db, "doc-7");
+    CHECK(doc != nullptr);
+    CBLDocument_Release(doc);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Expiration Scheduler") {
+    CBLError error;
+    for (int i = 0; i < 5; ++i) {
+        string docID = "doc-" + to_string(i);
+        createDocument(db, docID.c_str(), "n", "x");
+        if (i < 3)
+            REQUIRE(CBLDatabase_SetDocumentExpiration(db, docID.c_str(), time(nullptr) - 10, &error));
+    }
+    // An expired tombstone is purged too:
+    REQUIRE(CBLDatabase_DeleteDocumentByID(db, "doc-3", &error));
+    REQUIRE(CBLDatabase_SetDocumentExpiration(db, "doc-3", time(nullptr) - 10, &error));
+
+    CBLExpirationSchedulerOptions options = {};
+    options.maxDocsPerTransaction = 2;
+    REQUIRE(CBLDatabase_StartExpirationScheduler(db, &options, &error));
+    for (int i = 0; i < 1000 && CBLDatabase_ExpirationStats(db).docsPurged < 4; ++i)
+        this_thread::sleep_for(chrono::milliseconds(10));
+    CBLDatabase_StopExpirationScheduler(db);
+
+    CBLExpirationStats stats = CBLDatabase_ExpirationStats(db);
+    CHECK(stats.docsPurged == 4);
+    CHECK(stats.transactions == 2);
+    CHECK(stats.maxLagSeconds >= 10);
+    CHECK(CBLDatabase_Count(db) == 1);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Database Stats") {
+    for (int i = 0; i < 10; ++i)
+        createDocument(db, ("doc-" + to_string(i)).c_str(), "n", "x");
+    CBLError error;
+    CBLIndexSpec index = {kCBLValueIndex, "[[\".n\"]]"};
+    REQUIRE(CBLDatabase_CreateIndex(db, "byN", index, &error));
+
+    CBLDatabaseStats stats;
+    REQUIRE(CBLDatabase_GetStats(db, &stats, &error));
+    CHECK(stats.fileSize > 0);
+    CHECK(stats.pageSize > 0);
+    CHECK(stats.pageCount > 0);
+    CHECK(stats.freePageCount < stats.pageCount);
+    CHECK(stats.blobCount == 0);
+    CHECK(stats.blobsSize == 0);
+    CHECK(stats.indexCount == 1);
+    CHECK(stats.documentCount == 10);
+    CHECK(stats.averageDocumentSize > 0);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Storage Tuning") {
+    static const char* const kTunedName = "CBLtest-tuned";
+    CBLError error;
+    CBL_DeleteDatabase(kTunedName, kDatabaseConfiguration.directory, &error);
+
+    CBLDatabaseConfiguration config = kDatabaseConfiguration;
+    config.readerCount = 2;
+    config.tuning.pageCacheSize = 4096;
+    config.tuning.mmapSize = -1;
+    config.tuning.durability = kCBLDurabilityFull;
+    config.tuning.walAutoCheckpoint = 500;
+    config.tuning.journalSizeLimit = 1000000;
+    CBLDatabase *tuned = CBLDatabase_Open(kTunedName, &config, &error);
+    REQUIRE(tuned);
+
+    // The settings are applied to the main connection and to every reader:
+    for (int conn = -1; conn < 2; ++conn) {
+        INFO("Connection " << conn);
+        int64_t value;
+        REQUIRE(CBLDatabase_GetPragma(tuned, conn, "cache_size", &value));
+        CHECK(value == -4096);
+        REQUIRE(CBLDatabase_GetPragma(tuned, conn, "mmap_size", &value));
+        CHECK(value == 0);
+        REQUIRE(CBLDatabase_GetPragma(tuned, conn, "synchronous", &value));
+        CHECK(value == 2);                  // FULL
+        REQUIRE(CBLDatabase_GetPragma(tuned, conn, "wal_autocheckpoint", &value));
+        CHECK(value == 500);
+        REQUIRE(CBLDatabase_GetPragma(tuned, conn, "journal_size_limit", &value));
+        CHECK(value == 1000000);
+    }
+    int64_t value;
+    CHECK(!CBLDatabase_GetPragma(tuned, 2, "cache_size", &value));
+
+    CHECK(CBLDatabase_Delete(tuned, &error));
+    CBLDatabase_Release(tuned);
+}
+
+
+static int64_t queryCount(CBLQuery *query) {
+    CBLError error;
+    CBLResultSet *rs = CBLQuery_Execute(query, &error);
+    REQUIRE(rs);
+    REQUIRE(CBLResultSet_Next(rs));
+    int64_t count = FLValue_AsInt(CBLResultSet_ValueAtIndex(rs, 0));
+    CBLResultSet_Release(rs);
+    return count;
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Reader Connections") {
+    static const char* const kReadersName = "CBLtest-readers";
+    CBLError error;
+    CBL_DeleteDatabase(kReadersName, kDatabaseConfiguration.directory, &error);
+    CBLDatabaseConfiguration config = kDatabaseConfiguration;
+    config.readerCount = 2;
+    CBLDatabase *rdb = CBLDatabase_Open(kReadersName, &config, &error);
+    REQUIRE(rdb);
+    for (int i = 0; i < 5; ++i)
+        createDocument(rdb, ("doc-" + to_string(i)).c_str(), "n", "x");
+
+    // Reads and queries go to the readers in turn, and see all committed changes:
+    CBLQuery *query = CBLQuery_New(rdb, kCBLN1QLLanguage, "SELECT count(*)", nullptr, &error);
+    REQUIRE(query);
+    for (int i = 0; i < 4; ++i) {
+        CHECK(queryCount(query) == 5);
+        const CBLDocument *doc = CBLDatabase_GetDocument(rdb, "doc-4");
+        CHECK(doc != nullptr);
+        CBLDocument_Release(doc);
+    }
+
+    // During a batch they use the main connection, so they see the uncommitted changes:
+    REQUIRE(CBLDatabase_BeginBatch(rdb, &error));
+    createDocument(rdb, "doc-5", "n", "x");
+    const CBLDocument *doc = CBLDatabase_GetDocument(rdb, "doc-5");
+    CHECK(doc != nullptr);
+    CBLDocument_Release(doc);
+    CHECK(queryCount(query) == 6);
+    REQUIRE(CBLDatabase_EndBatch(rdb, &error));
+    CHECK(queryCount(query) == 6);
+
+    // Closing the database while the query (compiled on the readers) still exists:
+    CHECK(CBLDatabase_Close(rdb, &error));
+    CBLQuery_Release(query);
+    CBLDatabase_Release(rdb);
+    CHECK(CBL_DeleteDatabase(kReadersName, kDatabaseConfiguration.directory, &error));
+}
+
+
+static bool backupProgress(void *context, uint64_t pagesCopied, uint64_t totalPages) {
+    CHECK(pagesCopied <= totalPages);
+    ++*(int*)context;
+    return true;
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Backup") {
+    static const char* const kBackupName = "CBLtest-backup";
+    string backupPath = kDatabaseDir + "/" + kBackupName + ".cblite2";
+    CBLError error;
+    CBL_DeleteDatabase(kBackupName, kDatabaseConfiguration.directory, &error);
+
+    for (int i = 0; i < 100; ++i)
+        createDocument(db, ("doc-" + to_string(i)).c_str(), "n", "x");
+    int steps = 0;
+    CBLBackupOptions options = {};
+    options.pagesPerStep = 2;
+    options.progress = backupProgress;
+    options.context = &steps;
+    REQUIRE(CBLDatabase_Backup(db, backupPath.c_str(), &options, &error));
+    CHECK(steps > 1);
+
+    // Replacing the previous backup:
+    for (int i = 100; i < 150; ++i)
+        createDocument(db, ("doc-" + to_string(i)).c_str(), "n", "x");
+    REQUIRE(CBLDatabase_Backup(db, backupPath.c_str(), &options, &error));
+
+    // A cancelled backup leaves the previous one intact:
+    createDocument(db, "doc-150", "n", "x");
+    options.progress = [](void*, uint64_t, uint64_t) {return false;};
+    CHECK(!CBLDatabase_Backup(db, backupPath.c_str(), &options, &error));
+
+    CBLDatabase *backup = CBLDatabase_Open(kBackupName, &kDatabaseConfiguration, &error);
+    REQUIRE(backup);
+    CHECK(CBLDatabase_Count(backup) == 150);
+    const CBLDocument *doc = CBLDatabase_GetDocument(backup, "doc-149");
+    CHECK(doc != nullptr);
+    CBLDocument_Release(doc);
+    CHECK(CBLDatabase_Delete(backup, &error));
+    CBLDatabase_Release(backup);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Snapshot") {
+    for (int i = 0; i < 5; ++i)
+        createDocument(db, ("doc-" + to_string(i)).c_str(), "n", "x");
+    CBLError error;
+    CBLQuery *query = CBLQuery_New(db, kCBLN1QLLanguage, "SELECT count(*)", nullptr, &error);
+    REQUIRE(query);
+
+    CBLSnapshot *snapshot = CBLDatabase_BeginSnapshot(db, &error);
+    REQUIRE(snapshot);
+    // Change the database after the snapshot begins:
+    REQUIRE(CBLDatabase_PurgeDocumentByID(db, "doc-0", &error));
+    createDocument(db, "doc-5", "n", "x");
+    createDocument(db, "doc-6", "n", "x");
+
+    const CBLDocument *doc = CBLSnapshot_GetDocument(snapshot, "doc-0");
+    CHECK(doc != nullptr);
+    CBLDocument_Release(doc);
+    doc = CBLSnapshot_GetDocument(snapshot, "doc-5");
+    CHECK(doc == nullptr);
+
+    CBLResultSet *rs = CBLSnapshot_ExecuteQuery(snapshot, query, &error);
+    REQUIRE(rs);
+    REQUIRE(CBLResultSet_Next(rs));
+    CHECK(FLValue_AsInt(CBLResultSet_ValueAtIndex(rs, 0)) == 5);
+    CBLResultSet_Release(rs);
+    CBLSnapshot_End(snapshot);
+
+    rs = CBLQuery_Execute(query, &error);
+    REQUIRE(rs);
+    REQUIRE(CBLResultSet_Next(rs));
+    CHECK(FLValue_AsInt(CBLResultSet_ValueAtIndex(rs, 0)) == 6);
+    CBLResultSet_Release(rs);
+    CBLQuery_Release(query);
+}
+
+
+static vector<string> enumerateDocIDs(CBLDatabase *db, const CBLEnumeratorOptions &options) {
+    vector<string> docIDs;
+    CBLError error;
+    CBLDocumentEnumerator *e = CBLDatabase_EnumerateDocuments(db, &options, &error);
+    REQUIRE(e);
+    const CBLDocument* docs[3];
+    size_t n;
+    while ((n = CBLDocumentEnumerator_Next(e, docs, 3, &error)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            docIDs.push_back(CBLDocument_ID(docs[i]));
+            CBLDocument_Release(docs[i]);
+        }
+    }
+    CHECK(error.code == 0);
+    CBLDocumentEnumerator_Free(e);
+    return docIDs;
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Enumerate Documents") {
+    for (int i = 0; i < 8; ++i)
+        createDocument(db, ("doc-" + to_string(i)).c_str(), "n", "x");
+    CBLDocumentInfo info;
+    CBLError error;
+    REQUIRE(CBLDatabase_GetDocumentInfo(db, "doc-7", 0, &info, &error));
+    createDocument(db, "doc-9", "n", "x");
+    createDocument(db, "doc-8", "n", "x");
+
+    CBLEnumeratorOptions options = {};
+    CHECK(enumerateDocIDs(db, options).size() == 10);
+
+    options.startDocID = "doc-2";
+    options.endDocID = "doc-5";
+    CHECK((enumerateDocIDs(db, options) == vector<string>{"doc-2", "doc-3", "doc-4", "doc-5"}));
+
+    options.descending = true;
+    options.startDocID = "doc-5";
+    options.endDocID = "doc-2";
+    CHECK((enumerateDocIDs(db, options) == vector<string>{"doc-5", "doc-4", "doc-3", "doc-2"}));
+
+    options = {};
+    options.sinceSequence = info.sequence;
+    options.metadataOnly = true;
+    CHECK((enumerateDocIDs(db, options) == vector<string>{"doc-9", "doc-8"}));
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Enumerate Deleted Documents") {
+    for (int i = 0; i < 3; ++i)
+        createDocument(db, ("doc-" + to_string(i)).c_str(), "n", "x");
+    CBLError error;
+    REQUIRE(CBLDatabase_DeleteDocumentByID(db, "doc-1", &error));
+
+    CBLEnumeratorOptions options = {};
+    CHECK((enumerateDocIDs(db, options) == vector<string>{"doc-0", "doc-2"}));
+
+    // A tombstone is returned, with empty properties, even though bodies are being read:
+    options.includeDeleted = true;
+    CBLDocumentEnumerator *e = CBLDatabase_EnumerateDocuments(db, &options, &error);
+    REQUIRE(e);
+    const CBLDocument* docs[5];
+    size_t n = CBLDocumentEnumerator_Next(e, docs, 5, &error);
+    CHECK(error.code == 0);
+    REQUIRE(n == 3);
+    CHECK(string(CBLDocument_ID(docs[1])) == "doc-1");
+    CHECK(FLDict_Count(CBLDocument_Properties(docs[1])) == 0);
+    CHECK("x"_sl == FLValue_AsString(FLDict_Get(CBLDocument_Properties(docs[2]), "n"_sl)));
+    for (size_t i = 0; i < n; ++i)
+        CBLDocument_Release(docs[i]);
+    CBLDocumentEnumerator_Free(e);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Enumerate Metadata Only") {
+    createDocument(db, "foo", "greeting", "Howdy!");
+    CBLEnumeratorOptions options = {};
+    options.metadataOnly = true;
+    CBLError error;
+    CBLDocumentEnumerator *e = CBLDatabase_EnumerateDocuments(db, &options, &error);
+    REQUIRE(e);
+    const CBLDocument* doc;
+    REQUIRE(CBLDocumentEnumerator_Next(e, &doc, 1, &error) == 1);
+    CHECK(CBLDocument_Sequence(doc) > 0);
+    // The doc has no body, so a mutable copy (which could be saved) isn't allowed:
+    CHECK(CBLDocument_MutableCopy(doc) == nullptr);
+    CBLDocument_Release(doc);
+    CBLDocumentEnumerator_Free(e);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Changes Feed") {
+    for (int i = 0; i < 5; ++i)
+        createDocument(db, ("doc-" + to_string(i)).c_str(), "n", "x");
+    CBLError error;
+    REQUIRE(CBLDatabase_DeleteDocumentByID(db, "doc-1", &error));
+
+    // Read the feed in batches of 2:
+    vector<string> docIDs;
+    uint64_t since = CBLDatabase_GetChangesCursor(db, "test", &error);
+    CHECK(since == 0);
+    CHECK(error.code == 0);
+    CBLChanges *changes;
+    size_t count;
+    do {
+        changes = CBLDatabase_GetChangesSince(db, since, 2, &error);
+        REQUIRE(changes);
+        CHECK(changes->count <= 2);
+        for (size_t i = 0; i < changes->count; ++i) {
+            CHECK(changes->changes[i].sequence > since);
+            docIDs.push_back(string(slice(changes->changes[i].docID)));
+            if (docIDs.back() == "doc-1")
+                CHECK((changes->changes[i].flags & kCBLDocumentFlagsDeleted) != 0);
+        }
+        since = changes->lastSequence;
+        count = changes->count;
+        CBLChanges_Free(changes);
+    } while (count == 2);
+    CHECK((docIDs == vector<string>{"doc-0", "doc-2", "doc-3", "doc-4", "doc-1"}));
+
+    // Save the cursor; only later changes are returned after resuming from it:
+    REQUIRE(CBLDatabase_SetChangesCursor(db, "test", since, &error));
+    createDocument(db, "doc-5", "n", "x");
+    since = CBLDatabase_GetChangesCursor(db, "test", &error);
+    changes = CBLDatabase_GetChangesSince(db, since, 0, &error);
+    REQUIRE(changes);
+    REQUIRE(changes->count == 1);
+    CHECK(slice(changes->changes[0].docID) == "doc-5"_sl);
+    CBLChanges_Free(changes);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Auto Compaction") {
+    // Create a bunch of large-ish docs, then purge them to leave free pages in the file:
+    CBLError error;
+    string big(2000, 'x');
+    vector<string> docIDs;
+    REQUIRE(CBLDatabase_BeginBatch(db, &error));
+    for (int i = 0; i < 1000; ++i) {
+        docIDs.push_back("doc-" + to_string(i));
+        createDocument(db, docIDs.back().c_str(), "text", big.c_str());
+    }
+    REQUIRE(CBLDatabase_EndBatch(db, &error));
+    vector<const char*> ids;
+    for (auto &id : docIDs)
+        ids.push_back(id.c_str());
+    CHECK(CBLDatabase_PurgeDocumentsByID(db, ids.data(), ids.size(), 0, nullptr, nullptr,
+                                         &error) == 1000);
+
+    CBLAutoCompactionOptions options = {};
+    options.fragmentationThreshold = 0.1;
+    options.minFreeBytes = 1;
+    options.maxMillisPerStep = 5;
+    REQUIRE(CBLDatabase_StartAutoCompaction(db, &options, &error));
+    for (int i = 0; i < 1000 && CBLDatabase_CompactionStats(db).steps == 0; ++i)
+        this_thread::sleep_for(chrono::milliseconds(10));
+    CBLDatabase_StopAutoCompaction(db);
+
+    CBLCompactionStats stats = CBLDatabase_CompactionStats(db);
+    CHECK(stats.steps > 0);
+    CHECK(stats.bytesReclaimed > 0);
+    CHECK(stats.fileSize > 0);
+}
+
+
+static void batchChunk(void *context, CBLDatabase *db, uint64_t docs, uint64_t bytes) {
+    auto chunks = (vector<uint64_t>*)context;
+    chunks->push_back(docs);
+    CHECK(bytes > 0);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Auto Batch") {
+    vector<uint64_t> chunks;
+    CBLError error;
+    REQUIRE(CBLDatabase_BeginAutoBatch(db, 4, 0, batchChunk, &chunks, &error));
+    for (int i = 0; i < 10; ++i) {
+        createDocument(db, ("doc-" + to_string(i)).c_str(), "n", "x");
+        if (i == 4) {
+            // A nested batch postpones the chunk commit until it ends:
+            REQUIRE(CBLDatabase_BeginBatch(db, &error));
+            createDocument(db, "nested", "n", "x");
+            REQUIRE(CBLDatabase_EndBatch(db, &error));
+        }
+    }
+    CHECK((chunks == vector<uint64_t>{4, 4}));
+    REQUIRE(CBLDatabase_EndBatch(db, &error));
+    CHECK((chunks == vector<uint64_t>{4, 4, 3}));
+    CHECK(CBLDatabase_Count(db) == 11);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Auto Batch Commit Failure") {
+    vector<uint64_t> chunks;
+    CBLError error;
+    REQUIRE(CBLDatabase_BeginAutoBatch(db, 3, 0, batchChunk, &chunks, &error));
+    createDocument(db, "doc-0", "n", "x");
+    createDocument(db, "doc-1", "n", "x");
+
+    // The save that triggers the failed chunk commit fails:
+    CBLDatabase_FailNextChunkCommit(db);
+    CBLDocument *doc = CBLDocument_New("doc-2");
+    const CBLDocument *saved = CBLDatabase_SaveDocument(db, doc,
+                                                        kCBLConcurrencyControlFailOnConflict,
+                                                        &error);
+    CBLDocument_Release(doc);
+    CHECK(!saved);
+    CHECK(error.code != 0);
+    CHECK(CBLDatabase_Count(db) == 0);
+
+    // Later saves are committed on their own, and EndBatch reports the failure:
+    createDocument(db, "doc-3", "n", "x");
+    error = {};
+    CHECK(!CBLDatabase_EndBatch(db, &error));
+    CHECK(error.code != 0);
+    CHECK(chunks.empty());
+    CHECK(CBLDatabase_Count(db) == 1);
+
+    // The database is usable afterwards:
+    REQUIRE(CBLDatabase_BeginBatch(db, &error));
+    createDocument(db, "doc-4", "n", "x");
+    REQUIRE(CBLDatabase_EndBatch(db, &error));
+    CHECK(CBLDatabase_Count(db) == 2);
+}
+
+
 static int dbListenerCalls = 0;
 static int fooListenerCalls = 0;
 
@@ -210,3 +923,202 @@ TEST_CASE_METHOD(CBLTest, "Scheduled database notifications") {
     CBLListener_Remove(fooToken);
     CBLListener_Remove(barToken);
 }
+
+
+TEST_CASE_METHOD(CBLTest, "Coalesced database notifications") {
+    fooListenerCalls = 0;
+    createDocument(db, "foo", "greeting", "Howdy!");
+    auto fooToken = CBLDatabase_AddDocumentChangeListener(db, "foo", fooListener, this);
+    CBLDatabase_BufferNotifications(db, notificationsReady, this);
+    notificationsReadyCalls = 0;
+
+    // Update the doc many times; the listener is only queued once:
+    for (int i = 0; i < 50; ++i) {
+        CBLDocument *doc = CBLDatabase_GetMutableDocument(db, "foo");
+        REQUIRE(doc);
+        MutableDict props = CBLDocument_MutableProperties(doc);
+        props["n"] = i;
+        CBLError error;
+        auto saved = CBLDatabase_SaveDocument(db, doc, kCBLConcurrencyControlFailOnConflict,
+                                              &error);
+        REQUIRE(saved);
+        CBLDocument_Release(saved);
+        CBLDocument_Release(doc);
+    }
+    CHECK(notificationsReadyCalls == 1);
+    CHECK(fooListenerCalls == 0);
+    CBLDatabase_SendNotifications(db);
+    CHECK(fooListenerCalls == 1);
+
+    // After sending, a new change queues the listener again:
+    CBLError error;
+    REQUIRE(CBLDatabase_DeleteDocumentByID(db, "foo", &error));
+    CHECK(notificationsReadyCalls == 2);
+    CBLDatabase_SendNotifications(db);
+    CHECK(fooListenerCalls == 2);
+
+    CBLListener_Remove(fooToken);
+}
+
+
+static void rawListener(void *context, const CBLDatabase *db,
+                        unsigned nChanges, const CBLDatabaseChange changes[])
+{
+    auto calls = (vector<vector<string>>*)context;
+    calls->emplace_back();
+    for (unsigned i = 0; i < nChanges; ++i) {
+        CHECK(changes[i].sequence > 0);
+        CHECK(changes[i].bodySize > 0);
+        CHECK(!changes[i].external);
+        calls->back().push_back(string(slice(changes[i].docID)));
+    }
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Raw database notifications") {
+    vector<vector<string>> calls;
+    auto token = CBLDatabase_AddRawChangeListener(db, rawListener, 2, &calls);
+
+    // Raw listeners are called right away, even when notifications are buffered:
+    CBLDatabase_BufferNotifications(db, notificationsReady, this);
+    CBLError error;
+    REQUIRE(CBLDatabase_BeginBatch(db, &error));
+    for (int i = 0; i < 5; ++i)
+        createDocument(db, ("doc-" + to_string(i)).c_str(), "n", "x");
+    REQUIRE(CBLDatabase_EndBatch(db, &error));
+    CHECK((calls == vector<vector<string>>{{"doc-0", "doc-1"}, {"doc-2", "doc-3"}, {"doc-4"}}));
+
+    CBLListener_Remove(token);
+    calls.clear();
+    createDocument(db, "foo", "greeting", "Howdy!");
+    CHECK(calls.empty());
+}
+
+
+static void countingListener(void *context, const CBLDatabase *db,
+                             unsigned nDocs, const char** docIDs)
+{
+    *(atomic<unsigned>*)context += nDocs;
+}
+
+
+struct BatchingListenerState {
+    CBLTest* test;
+    vector<unsigned> batchSizes;
+    CBLListenerToken* addedToken;
+};
+
+static void batchingListener(void *context, const CBLDatabase *db,
+                             unsigned numChanges, const CBLDatabaseChange changes[])
+{
+    auto state = (BatchingListenerState*)context;
+    state->batchSizes.push_back(numChanges);
+    // Adding a listener from within a callback mustn't deadlock:
+    if (!state->addedToken)
+        state->addedToken = CBLDatabase_AddDocumentChangeListener(db, "foo", fooListener,
+                                                                   state->test);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Raw database notifications with large batches") {
+    BatchingListenerState state {this, {}, nullptr};
+    auto token = CBLDatabase_AddRawChangeListener(db, batchingListener, 250, &state);
+    CBLError error;
+    REQUIRE(CBLDatabase_BeginBatch(db, &error));
+    for (int i = 0; i < 300; ++i)
+        createDocument(db, ("doc-" + to_string(i)).c_str(), "n", "x");
+    REQUIRE(CBLDatabase_EndBatch(db, &error));
+    CHECK((state.batchSizes == vector<unsigned>{250, 50}));
+    CHECK(state.addedToken != nullptr);
+    CBLListener_Remove(state.addedToken);
+    CBLListener_Remove(token);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Add and remove listeners during notifications") {
+    atomic<unsigned> changes {0}, otherChanges {0};
+    auto token = CBLDatabase_AddChangeListener(db, countingListener, &changes);
+
+    // Another thread keeps adding and removing listeners while documents are saved:
+    atomic<bool> done {false};
+    thread churn([&]{
+        while (!done) {
+            auto t = CBLDatabase_AddChangeListener(db, countingListener, &otherChanges);
+            CBLListener_Remove(t);
+        }
+    });
+    for (int i = 0; i < 200; ++i)
+        createDocument(db, ("doc-" + to_string(i)).c_str(), "n", "x");
+    done = true;
+    churn.join();
+
+    CHECK(changes == 200);
+    CBLListener_Remove(token);
+}
+
+
+struct SlowListenerState {
+    atomic<bool> entered {false}, returned {false};
+};
+
+static void slowListener(void *context, const CBLDatabase *db,
+                         unsigned numChanges, const CBLDatabaseChange changes[])
+{
+    auto state = (SlowListenerState*)context;
+    state->entered = true;
+    this_thread::sleep_for(chrono::milliseconds(100));
+    state->returned = true;
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Remove listener waits for calls in progress") {
+    SlowListenerState state;
+    auto token = CBLDatabase_AddRawChangeListener(db, slowListener, 0, &state);
+    thread writer([&]{
+        createDocument(db, "foo", "greeting", "Howdy!");
+    });
+    while (!state.entered)
+        this_thread::yield();
+    CBLListener_Remove(token);
+    CHECK(state.returned);
+    writer.join();
+}
+
+
+static void importError(void *context, uint64_t lineNumber, const CBLError *error) {
+    ((vector<uint64_t>*)context)->push_back(lineNumber);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Import JSON Lines") {
+    string path = kDatabaseDir + "/import.ndjson";
+    {
+        ofstream out(path);
+        out << "{\"_id\":\"foo\",\"greeting\":\"Howdy!\"}\n";
+        out << "this is not JSON\n";
+        out << "\n";
+        out << "{\"_id\":\"bar\",\"greeting\":\"yo.\"}\n";
+        out << "{\"greeting\":\"no ID\"}\n";
+    }
+
+    vector<uint64_t> errorLines;
+    CBLImportOptions options = {};
+    options.threadCount = 2;
+    options.batchSize = 2;
+    options.error = importError;
+    options.context = &errorLines;
+    CBLError error;
+    CHECK(CBLDatabase_ImportJSONLines(db, path.c_str(), &options, &error) == 3);
+    CHECK(errorLines == vector<uint64_t>{2});
+    CHECK(CBLDatabase_Count(db) == 3);
+
+    const CBLDocument *doc = CBLDatabase_GetDocument(db, "bar");
+    REQUIRE(doc);
+    CHECK(Dict(CBLDocument_Properties(doc))["greeting"_sl].asString() == "yo."_sl);
+    CBLDocument_Release(doc);
+    remove(path.c_str());
+
+    CHECK(CBLDatabase_ImportJSONLines(db, path.c_str(), &options, &error) == -1);
+    CHECK(error.domain == CBLDomain);
+    CHECK(error.code == CBLErrorNotFound);
+}
@@ -93,6 +93,22 @@ static void createDocument(Database db, const char *docID,
 }
 
 
+TEST_CASE_METHOD(CBLTest_Cpp, "C++ Get Multiple Documents") {
+    createDocument(db, "foo", "greeting", "Howdy!");
+    createDocument(db, "bar", "greeting", "yo.");
+
+    auto docs = db.getDocuments({"foo", "missing", "bar"});
+    REQUIRE(docs.size() == 3);
+    REQUIRE(docs[0]);
+    CHECK(string(docs[0].id()) == "foo");
+    CHECK(docs[0]["greeting"].asString() == "Howdy!"_sl);
+    CHECK(!docs[1]);
+    REQUIRE(docs[2]);
+    CHECK(string(docs[2].id()) == "bar");
+    CHECK(docs[2]["greeting"].asString() == "yo."_sl);
+}
+
+
 TEST_CASE_METHOD(CBLTest_Cpp, "C++ Database notifications") {
     int dbListenerCalls = 0, fooListenerCalls = 0;
     {
@@ -0,0 +1,371 @@
+//
+// PerfTest.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// These are benchmarks, not tests; they're hidden by default. Run them with `CBL_C_Tests [.Perf]`
+
+#include "CBLTest.hh"
+#include "fleece/Fleece.hh"
+#include "fleece/Mutable.hh"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace fleece;
+
+
+static double elapsedSecs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Benchmark blob attach", "[.Perf]") {
+    static const int kBlobsPerThread = 20000;
+    static const slice kContents("This is a pretend thumbnail image.");
+
+    for (unsigned nThreads = 1; nThreads <= 8; nThreads *= 2) {
+        auto start = chrono::steady_clock::now();
+        vector<thread> threads;
+        for (unsigned t = 0; t < nThreads; ++t) {
+            threads.emplace_back([&]{
+                for (int i = 0; i < kBlobsPerThread; ++i) {
+                    CBLDocument *doc = CBLDocument_New(nullptr);
+                    CBLBlob *blob = CBLBlob_CreateWithData("image/jpeg", kContents);
+                    FLMutableDict_SetBlob(CBLDocument_MutableProperties(doc), "thumbnail"_sl, blob);
+                    CBLBlob_Release(blob);
+                    CBLDocument_Release(doc);
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        double secs = elapsedSecs(start);
+        printf("Blob attach, %u threads: %.0f blobs/sec\n",
+               nThreads, nThreads * kBlobsPerThread / secs);
+    }
+}
+
+
+// Creates a document whose body is about `size` bytes, spread over nested dicts.
+static void createBigDocument(CBLDatabase *db, const char *docID, size_t size) {
+    CBLDocument *doc = CBLDocument_New(docID);
+    MutableDict props = CBLDocument_MutableProperties(doc);
+    props["counter"_sl] = 0;
+    string filler(100, 'x');
+    for (size_t i = 0; i * 100 < size; ++i) {
+        MutableDict group = props.getMutableDict(slice(to_string(i / 100)));
+        if (!group) {
+            group = MutableDict::newDict();
+            props[slice(to_string(i / 100))] = group;
+        }
+        group[slice(to_string(i))] = slice(filler);
+    }
+    CBLError error;
+    const CBLDocument *saved = CBLDatabase_SaveDocument(db, doc, kCBLConcurrencyControlFailOnConflict,
+                                                        &error);
+    REQUIRE(saved);
+    CBLDocument_Release(saved);
+    CBLDocument_Release(doc);
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Benchmark mutable copy of a mutable document", "[.Perf]") {
+    static const int kIterations = 1000;
+
+    for (size_t size = 1000; size <= 1000000; size *= 10) {
+        string docID = "doc-" + to_string(size);
+        createBigDocument(db, docID.c_str(), size);
+        // Copying a mutable document is the path that copies the source's mutable collections
+        // and shares its unchanged immutable ones:
+        CBLDocument *original = CBLDatabase_GetMutableDocument(db, docID.c_str());
+        REQUIRE(original);
+        MutableDict(CBLDocument_MutableProperties(original))["counter"_sl] = 1;
+
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < kIterations; ++i) {
+            CBLDocument *copy = CBLDocument_MutableCopy(original);
+            MutableDict props = CBLDocument_MutableProperties(copy);
+            props["counter"_sl] = i + 1;
+            CBLDocument_Release(copy);
+        }
+        double secs = elapsedSecs(start);
+        printf("Mutable copy of mutable doc, %7zu-byte doc: %8.2f us/copy\n",
+               size, secs / kIterations * 1.0e6);
+        CBLDocument_Release(original);
+    }
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Benchmark JSON Lines import", "[.Perf]") {
+    static const int kNumDocs = 200000;
+
+    string path = kDatabaseDir + "/import-benchmark.ndjson";
+    {
+        ofstream out(path);
+        for (int i = 0; i < kNumDocs; ++i) {
+            out << "{\"_id\":\"doc-" << i << "\",\"name\":\"Document number " << i
+                << "\",\"tags\":[\"alpha\",\"beta\",\"gamma\"],\"location\":"
+                << "{\"lat\":" << (i % 90) << ".5,\"lon\":" << (i % 180) << ".25},"
+                << "\"count\":" << i << "}\n";
+        }
+    }
+
+    for (unsigned nThreads = 1; nThreads <= 8; nThreads *= 2) {
+        string dbName = "import-" + to_string(nThreads);
+        CBLError error;
+        CBL_DeleteDatabase(dbName.c_str(), kDatabaseDir.c_str(), &error);
+        CBLDatabase *importDB = CBLDatabase_Open(dbName.c_str(), &kDatabaseConfiguration, &error);
+        REQUIRE(importDB);
+
+        CBLImportOptions options = {};
+        options.threadCount = nThreads;
+        auto start = chrono::steady_clock::now();
+        CHECK(CBLDatabase_ImportJSONLines(importDB, path.c_str(), &options, &error) == kNumDocs);
+        double secs = elapsedSecs(start);
+        printf("JSON Lines import, %u threads: %.0f docs/sec\n", nThreads, kNumDocs / secs);
+
+        CHECK(CBLDatabase_Delete(importDB, &error));
+        CBLDatabase_Release(importDB);
+    }
+    remove(path.c_str());
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Benchmark async save", "[.Perf]") {
+    static const int kDocsPerThread = 2000;
+    static const unsigned kThreads = 8;
+
+    for (int async = 0; async <= 1; ++async) {
+        atomic<int> completed {0}, failed {0};
+        auto start = chrono::steady_clock::now();
+        vector<thread> threads;
+        for (unsigned t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&, t]{
+                for (int i = 0; i < kDocsPerThread; ++i) {
+                    string docID = "doc-" + to_string(async) + "-" + to_string(t) + "-" + to_string(i);
+                    CBLDocument *doc = CBLDocument_New(docID.c_str());
+                    MutableDict props = CBLDocument_MutableProperties(doc);
+                    props["n"_sl] = i;
+                    CBLError error;
+                    // (Catch assertions aren't thread-safe, so just count failures.)
+                    if (async) {
+                        if (!CBLDatabase_SaveDocumentAsync(db, doc,
+                                    kCBLConcurrencyControlFailOnConflict,
+                                    [](void *context, const CBLDocument*, const CBLError*) {
+                                        ++*(atomic<int>*)context;
+                                    },
+                                    &completed, &error))
+                            ++failed;
+                    } else {
+                        const CBLDocument *saved = CBLDatabase_SaveDocument(db, doc,
+                                                    kCBLConcurrencyControlFailOnConflict, &error);
+                        if (!saved)
+                            ++failed;
+                        CBLDocument_Release(saved);
+                        ++completed;
+                    }
+                    CBLDocument_Release(doc);
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        REQUIRE(failed == 0);
+        while (completed < int(kThreads * kDocsPerThread))
+            this_thread::sleep_for(chrono::milliseconds(1));
+        double secs = elapsedSecs(start);
+        printf("%s save, %u threads: %.0f docs/sec\n",
+               (async ? "Async" : "Sync"), kThreads, kThreads * kDocsPerThread / secs);
+    }
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Benchmark concurrent reads", "[.Perf]") {
+    static const int kNumDocs = 10000;
+    static const int kReadsPerThread = 50000;
+
+    CBLError error;
+    REQUIRE(CBLDatabase_BeginBatch(db, &error));
+    for (int i = 0; i < kNumDocs; ++i) {
+        string docID = "doc-" + to_string(i);
+        CBLDocument *doc = CBLDocument_New(docID.c_str());
+        MutableDict props = CBLDocument_MutableProperties(doc);
+        props["n"_sl] = i;
+        props["name"_sl] = slice("Document number " + to_string(i));
+        const CBLDocument *saved = CBLDatabase_SaveDocument(db, doc,
+                                                    kCBLConcurrencyControlFailOnConflict, &error);
+        REQUIRE(saved);
+        CBLDocument_Release(saved);
+        CBLDocument_Release(doc);
+    }
+    REQUIRE(CBLDatabase_EndBatch(db, &error));
+
+    for (uint32_t readers = 0; readers <= 8; readers += 8) {
+        CBLDatabaseConfiguration config = kDatabaseConfiguration;
+        config.readerCount = readers;
+        CBLDatabase *readDB = CBLDatabase_Open(kDatabaseName, &config, &error);
+        REQUIRE(readDB);
+        for (unsigned nThreads = 1; nThreads <= 8; nThreads *= 2) {
+            atomic<int> missing {0};
+            auto start = chrono::steady_clock::now();
+            vector<thread> threads;
+            for (unsigned t = 0; t < nThreads; ++t) {
+                threads.emplace_back([&, t]{
+                    for (int i = 0; i < kReadsPerThread; ++i) {
+                        string docID = "doc-" + to_string((i * 7919 + t) % kNumDocs);
+                        const CBLDocument *doc = CBLDatabase_GetDocument(readDB, docID.c_str());
+                        if (!doc)
+                            ++missing;
+                        CBLDocument_Release(doc);
+                    }
+                });
+            }
+            for (auto &thread : threads)
+                thread.join();
+            double secs = elapsedSecs(start);
+            CHECK(missing == 0);
+            printf("Concurrent reads, %u readers, %u threads: %.0f docs/sec\n",
+                   readers, nThreads, nThreads * kReadsPerThread / secs);
+        }
+        CHECK(CBLDatabase_Close(readDB, &error));
+        CBLDatabase_Release(readDB);
+    }
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Benchmark storage tuning", "[.Perf]") {
+    static const int kNumDocs = 5000;
+    static const int kNumQueries = 200;
+    static const char* const kTuningDBName = "CBLtest-tuning";
+
+    struct Variant {
+        const char *name;
+        CBLStorageTuning tuning;
+    };
+    vector<Variant> variants(7);
+    variants[0].name = "Defaults";
+    variants[1].name = "Durability full";
+    variants[1].tuning.durability = kCBLDurabilityFull;
+    variants[2].name = "Durability off";
+    variants[2].tuning.durability = kCBLDurabilityOff;
+    variants[3].name = "64MB page cache";
+    variants[3].tuning.pageCacheSize = 64 * 1024;
+    variants[4].name = "No mmap";
+    variants[4].tuning.mmapSize = -1;
+    variants[5].name = "No WAL autocheckpoint";
+    variants[5].tuning.walAutoCheckpoint = -1;
+    variants[6].name = "1MB journal size limit";
+    variants[6].tuning.journalSizeLimit = 1024 * 1024;
+
+    for (auto &variant : variants) {
+        CBLError error;
+        CBL_DeleteDatabase(kTuningDBName, kDatabaseConfiguration.directory, &error);
+        CBLDatabaseConfiguration config = kDatabaseConfiguration;
+        config.tuning = variant.tuning;
+        CBLDatabase *tunedDB = CBLDatabase_Open(kTuningDBName, &config, &error);
+        REQUIRE(tunedDB);
+
+        // Inserts, one transaction per doc, so syncing matters:
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < kNumDocs; ++i) {
+            string docID = "doc-" + to_string(i);
+            CBLDocument *doc = CBLDocument_New(docID.c_str());
+            MutableDict props = CBLDocument_MutableProperties(doc);
+            props["n"_sl] = i;
+            props["name"_sl] = slice("Document number " + to_string(i));
+            const CBLDocument *saved = CBLDatabase_SaveDocument(tunedDB, doc,
+                                                    kCBLConcurrencyControlFailOnConflict, &error);
+            REQUIRE(saved);
+            CBLDocument_Release(saved);
+            CBLDocument_Release(doc);
+        }
+        double insertsPerSec = kNumDocs / elapsedSecs(start);
+
+        // Queries that scan the whole database:
+        CBLQuery *query = CBLQuery_New(tunedDB, kCBLN1QLLanguage,
+                                       "SELECT count(*) WHERE n % 7 = 0", nullptr, &error);
+        REQUIRE(query);
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < kNumQueries; ++i) {
+            CBLResultSet *rs = CBLQuery_Execute(query, &error);
+            REQUIRE(rs);
+            CHECK(CBLResultSet_Next(rs));
+            CBLResultSet_Release(rs);
+        }
+        double queriesPerSec = kNumQueries / elapsedSecs(start);
+        CBLQuery_Release(query);
+
+        printf("%-24s %8.0f inserts/sec, %8.0f queries/sec\n",
+               variant.name, insertsPerSec, queriesPerSec);
+        CHECK(CBLDatabase_Delete(tunedDB, &error));
+        CBLDatabase_Release(tunedDB);
+    }
+}
+
+
+static void countingDocListener(void *context, const CBLDatabase *db, const char *docID) {
+    ++*(atomic<int>*)context;
+}
+
+
+TEST_CASE_METHOD(CBLTest, "Benchmark document listeners", "[.Perf]") {
+    static const int kNumCommits = 1000;
+
+    for (int nListeners = 1000; nListeners <= 100000; nListeners *= 10) {
+        // Add a listener to each of nListeners docIDs:
+        atomic<int> calls {0};
+        vector<CBLListenerToken*> tokens;
+        tokens.reserve(nListeners);
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < nListeners; ++i) {
+            string docID = "session-" + to_string(nListeners) + "-" + to_string(i);
+            tokens.push_back(CBLDatabase_AddDocumentChangeListener(db, docID.c_str(),
+                                                                   countingDocListener, &calls));
+        }
+        double addSecs = elapsedSecs(start);
+
+        // Save some of those docs, one transaction each:
+        CBLError error;
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < kNumCommits; ++i) {
+            string docID = "session-" + to_string(nListeners) + "-" + to_string(i);
+            CBLDocument *doc = CBLDocument_New(docID.c_str());
+            MutableDict props = CBLDocument_MutableProperties(doc);
+            props["n"_sl] = i;
+            const CBLDocument *saved = CBLDatabase_SaveDocument(db, doc,
+                                                    kCBLConcurrencyControlFailOnConflict, &error);
+            REQUIRE(saved);
+            CBLDocument_Release(saved);
+            CBLDocument_Release(doc);
+        }
+        double commitsPerSec = kNumCommits / elapsedSecs(start);
+        CHECK(calls == kNumCommits);
+
+        start = chrono::steady_clock::now();
+        for (auto token : tokens)
+            CBLListener_Remove(token);
+        double removeSecs = elapsedSecs(start);
+
+        printf("%6d doc listeners: add %.3f sec, %8.0f commits/sec, remove %.3f sec\n",
+               nListeners, addSecs, commitsPerSec, removeSecs);
+    }
+}